@@ -0,0 +1,88 @@
+#include "AhoCorasick.h"
+#include <queue>
+#include <stdexcept>
+
+void AhoCorasick::compile(std::vector<std::string> const& literals) {
+    *this = AhoCorasick();
+    if(literals.empty()) return;
+
+    for (auto &literal : literals) {
+        if(literal.empty()) throw std::logic_error("Aho-Corasick literals can't be empty");
+        for (auto &sym : literal) classes_[static_cast<unsigned char>(sym)] = 1;
+    }
+    classes_count_ = 1;
+    for (auto &i : classes_) {
+        if(i) i = classes_count_++;
+    }
+
+    // Trie first, missing children are 'none' until the failure links fill them
+    constexpr unsigned int none = static_cast<unsigned int>(-1);
+    table_.assign(classes_count_, none);
+    depth_.assign(1, 0);
+    longest_.assign(1, 0);
+    for (auto &literal : literals) {
+        unsigned int state = 0;
+        for (auto &sym : literal) {
+            unsigned int & next = table_[state * classes_count_ + classes_[static_cast<unsigned char>(sym)]];
+            if(next == none) {
+                next = depth_.size();
+                depth_.push_back(depth_[state] + 1);
+                longest_.push_back(0);
+                table_.resize(table_.size() + classes_count_, none);
+            }
+            state = table_[state * classes_count_ + classes_[static_cast<unsigned char>(sym)]];
+        }
+        longest_[state] = literal.size();
+    }
+
+    std::vector<unsigned int> fail(depth_.size(), 0);
+    std::queue<unsigned int> states;
+    for (unsigned int c = 0; c < classes_count_; ++c) {
+        unsigned int & next = table_[c];
+        if(next == none) next = 0;
+        else states.push(next);
+    }
+    while (!states.empty()) {
+        unsigned int state = states.front();
+        states.pop();
+        longest_[state] = std::max(longest_[state], longest_[fail[state]]);
+        for (unsigned int c = 0; c < classes_count_; ++c) {
+            unsigned int & next = table_[state * classes_count_ + c];
+            unsigned int fallback = table_[fail[state] * classes_count_ + c];
+            if(next == none) { next = fallback; continue; }
+            fail[next] = fallback;
+            states.push(next);
+        }
+    }
+
+    unsigned int first_count = 0;
+    for (unsigned int b = 0; b < 256; ++b) {
+        if(table_[classes_[b]] == 0) continue;
+        if(first_count == compiled_state::max_escapes) { first_count = 0; break; }
+        first_bytes_[first_count++] = static_cast<unsigned char>(b);
+    }
+    first_count_ = first_count;
+}
+
+bool AhoCorasick::isEmpty() const noexcept { return table_.empty(); }
+
+unsigned long AhoCorasick::getStatesCount() const noexcept { return depth_.size(); }
+
+// The state is the longest suffix of the read bytes that is a trie prefix, so no literal found
+// later starts before the start of this suffix: the scan stops when it passes the best start
+tag_type::tag_value AhoCorasick::leftmostStart(std::string_view str, tag_type::tag_value from) const {
+    if(isEmpty()) return tag_type::empty;
+    tag_type::tag_value best = tag_type::empty;
+    unsigned int state = 0;
+    const char * data = str.data();
+    for (tag_type::tag_value pos = from; pos < str.size(); ++pos) {
+        if(state == 0 && first_count_) {
+            pos = findEscape(data + pos, data + str.size(), first_bytes_, first_count_) - data;
+            if(pos == str.size()) break;
+        }
+        state = table_[state * classes_count_ + classes_[static_cast<unsigned char>(data[pos])]];
+        if(longest_[state]) best = std::min(best, pos + 1 - longest_[state]);
+        if(best != tag_type::empty && pos + 1 - depth_[state] >= best) break;
+    }
+    return best;
+}
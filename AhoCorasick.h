@@ -0,0 +1,33 @@
+#ifndef LAB2_AHOCORASICK_H
+#define LAB2_AHOCORASICK_H
+
+#include "CompiledDFA.h"
+#include <vector>
+#include <string>
+#include <string_view>
+#include <array>
+
+// Aho–Corasick automaton of a set of non-empty literals as a dense table over the byte
+// classes of the literals: failure links are folded into the table, so every byte is one load.
+// The root skips to the next first byte of a literal when there are few of them
+class AhoCorasick {
+    std::vector<unsigned int> table_;
+    // Bytes missing in the literals are class 0
+    std::array<unsigned short, 256> classes_ {};
+    unsigned int classes_count_ = 0;
+    // Length of the string of the state and of the longest literal ending there, 0 for none
+    std::vector<unsigned int> depth_;
+    std::vector<unsigned int> longest_;
+    unsigned char first_bytes_[compiled_state::max_escapes] {};
+    unsigned int first_count_ = 0;
+public:
+    AhoCorasick() = default;
+    void compile(std::vector<std::string> const& literals);
+    [[nodiscard]] bool isEmpty() const noexcept;
+    [[nodiscard]] unsigned long getStatesCount() const noexcept;
+    // Leftmost position from 'from' where a literal starts or tag_type::empty
+    [[nodiscard]] tag_type::tag_value leftmostStart(std::string_view str, tag_type::tag_value from) const;
+    ~AhoCorasick() = default;
+};
+
+#endif //LAB2_AHOCORASICK_H
@@ -0,0 +1,143 @@
+#include "BackReference.h"
+#include <set>
+#include <stack>
+#include <algorithm>
+
+void BackReferenceMatcher::synthesisFromNFA(const NFA_Automata *nfa_auto) {
+    *this = BackReferenceMatcher();
+    std::vector<std::pair<State*, std::string>> references;
+    std::set<State *> visited;
+    std::stack<State *> stack;
+    stack.push(nfa_auto->getBeginConnector());
+
+    while (!stack.empty()) {
+        State * working = stack.top();
+        stack.pop();
+        if(visited.count(working)) continue;
+        visited.insert(working);
+        indexes_[working] = indexes_.size();
+
+        // The language of the group behind a back reference exists for the DFA only
+        auto ref_state = dynamic_cast<BackReferenceState*>(working);
+        if(ref_state) references.emplace_back(working, ref_state->getCaptureGroupName());
+
+        for (auto &i : working->getTransitions()) {
+            if(ref_state && !compaireTransition<BackReferenceTransition>(i)) continue;
+            if(!visited.count(i->getNextState())) stack.push(i->getNextState());
+        }
+    }
+
+    if(references.empty()) { *this = BackReferenceMatcher(); return; }
+
+    tags_ = nfa_auto->captureGroupTags(groups_);
+    std::set<unsigned int> referenced;
+    for (auto &i : references) {
+        auto group = std::find(groups_.begin(), groups_.end(), i.second);
+        if(group == groups_.end()) throw std::logic_error("Capture group of back reference is not founded");
+        references_[i.first] = group - groups_.begin();
+        referenced.insert(group - groups_.begin());
+    }
+    for (auto &i : referenced) {
+        memo_tags_.push_back(2 * i);
+        memo_tags_.push_back(2 * i + 1);
+    }
+
+    start_ = nfa_auto->getBeginConnector();
+    end_ = nfa_auto->getEndConnector();
+}
+
+void BackReferenceMatcher::setMaxConfigurations(unsigned long max_configurations) noexcept { max_configurations_ = max_configurations; }
+
+bool BackReferenceMatcher::isEmpty() const noexcept { return references_.empty(); }
+
+const std::vector<std::string> &BackReferenceMatcher::getGroups() const noexcept { return groups_; }
+
+std::size_t BackReferenceMatcher::KeyHash::operator()(std::vector<tag_type::tag_value> const& key) const noexcept {
+    std::size_t hash = 0;
+    for (auto &i : key) hash = hash * 1000003 + i;
+    return hash;
+}
+
+bool BackReferenceMatcher::isExhausted() const noexcept { return exhausted_; }
+
+tag_type::match_tags BackReferenceMatcher::match(std::string_view str, std::vector<tag_type::tag_value> &registers) {
+    return search(str, registers, nullptr);
+}
+
+void BackReferenceMatcher::matchEnds(std::string_view str, tag_type::tag_value from, std::vector<tag_type::tag_value> &ends) {
+    ends.clear();
+    // Registers are filled by the first-match search only
+    std::vector<tag_type::tag_value> unused;
+    (void)search(str.substr(from), unused, &ends);
+    if(exhausted_) { ends.clear(); return; }
+    std::sort(ends.begin(), ends.end());
+    ends.erase(std::unique(ends.begin(), ends.end()), ends.end());
+    for (auto &i : ends) i += from;
+}
+
+tag_type::match_tags BackReferenceMatcher::search(std::string_view str, std::vector<tag_type::tag_value> &registers, std::vector<tag_type::tag_value> * ends) {
+    exhausted_ = false;
+    if(isEmpty()) return std::nullopt;
+
+    struct Configuration {
+        State * state_;
+        unsigned long pos_;
+        std::vector<tag_type::tag_value> tags_;
+    };
+
+    visited_.clear();
+    std::stack<Configuration> stack;
+    stack.push({start_, 0, std::vector<tag_type::tag_value>(2 * groups_.size(), tag_type::empty)});
+
+    // Depth-first in priority order: the first accepted path is the one a backtracking matcher would take
+    while (!stack.empty()) {
+        Configuration working = std::move(stack.top());
+        stack.pop();
+
+        auto tag = tags_.find(working.state_);
+        if(tag != tags_.end()) working.tags_[tag->second] = working.pos_;
+
+        std::vector<tag_type::tag_value> key;
+        key.reserve(memo_tags_.size() + 2);
+        key.push_back(indexes_.find(working.state_)->second);
+        key.push_back(working.pos_);
+        for (auto &i : memo_tags_) key.push_back(working.tags_[i]);
+        if(!visited_.insert(std::move(key)).second) continue;
+        if(visited_.size() > max_configurations_) { exhausted_ = true; return std::nullopt; }
+
+        if(ends && working.state_ == end_) ends->push_back(working.pos_);
+        if(!ends && working.state_ == end_ && working.pos_ == str.size()) {
+            registers.assign(working.tags_.begin(), working.tags_.end());
+            return std::span<const tag_type::tag_value>(registers);
+        }
+
+        auto reference = references_.find(working.state_);
+        if(reference != references_.end()) {
+            tag_type::tag_value start = working.tags_[2 * reference->second];
+            tag_type::tag_value finish = working.tags_[2 * reference->second + 1];
+            if(start == tag_type::empty || finish == tag_type::empty || start > finish) continue;
+            unsigned long length = finish - start;
+            if(str.size() - working.pos_ < length || str.substr(working.pos_, length) != str.substr(start, length)) continue;
+            for (auto &i : working.state_->getTransitions()) {
+                if(compaireTransition<BackReferenceTransition>(i)) {
+                    stack.push({i->getNextState(), working.pos_ + length, working.tags_});
+                }
+            }
+            continue;
+        }
+
+        auto ordered = priorityTransitions(working.state_);
+        for (auto i = ordered.rbegin(); i != ordered.rend(); ++i) {
+            auto sym_transition = dynamic_cast<SymbolTransition*>(*i);
+            auto class_transition = dynamic_cast<SymbolClassTransition*>(*i);
+            if(sym_transition || class_transition) {
+                bool consumes = working.pos_ < str.size() &&
+                        (sym_transition ? str[working.pos_] == sym_transition->getSymbol() : class_transition->hasSymbol(str[working.pos_]));
+                if(consumes) stack.push({(*i)->getNextState(), working.pos_ + 1, working.tags_});
+            } else if(compaireTransition<EpsilonTransition>(*i)) {
+                stack.push({(*i)->getNextState(), working.pos_, working.tags_});
+            }
+        }
+    }
+    return std::nullopt;
+}
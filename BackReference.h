@@ -0,0 +1,55 @@
+#ifndef LAB2_BACKREFERENCE_H
+#define LAB2_BACKREFERENCE_H
+
+#include "NFA.h"
+#include "TaggedDFA.h"
+#include <vector>
+#include <string>
+#include <string_view>
+#include <map>
+#include <unordered_set>
+
+namespace backreference_options {
+    inline constexpr unsigned long max_configurations = 1 << 22;
+}
+
+// NFA simulator for patterns with back references. A configuration is an NFA state, a position
+// and the captures of the referenced groups only, every configuration is expanded once,
+// so the matching time is polynomial and limited by 'max_configurations'. A search running
+// out of the budget gives no match and is reported by isExhausted
+class BackReferenceMatcher {
+    struct KeyHash {
+        std::size_t operator()(std::vector<tag_type::tag_value> const& key) const noexcept;
+    };
+
+    State * start_ = nullptr;
+    State * end_ = nullptr;
+    std::vector<std::string> groups_;
+    std::map<State*, unsigned int> tags_;
+    std::map<State*, unsigned int> references_;
+    std::map<State*, unsigned long> indexes_;
+    std::vector<unsigned int> memo_tags_;
+    unsigned long max_configurations_ = backreference_options::max_configurations;
+    // Scratch of the searches: expanded configurations as the state index, the position and the memo tags
+    std::unordered_set<std::vector<tag_type::tag_value>, KeyHash> visited_;
+    bool exhausted_ = false;
+
+    // With 'ends' every end of a path is added there and the search goes on,
+    // otherwise it stops at the first path to the end of the string
+    [[nodiscard]] tag_type::match_tags search(std::string_view str, std::vector<tag_type::tag_value> & registers, std::vector<tag_type::tag_value> * ends);
+public:
+    BackReferenceMatcher() = default;
+    void synthesisFromNFA(const NFA_Automata * nfa_auto);
+    void setMaxConfigurations(unsigned long max_configurations) noexcept;
+    [[nodiscard]] bool isEmpty() const noexcept;
+    [[nodiscard]] std::vector<std::string> const& getGroups() const noexcept;
+    // Same contract as TaggedDFA_Automata::match
+    [[nodiscard]] tag_type::match_tags match(std::string_view str, std::vector<tag_type::tag_value> & registers);
+    // Every end of a match starting at 'from' in increasing order, found by one search
+    void matchEnds(std::string_view str, tag_type::tag_value from, std::vector<tag_type::tag_value> & ends);
+    // The last search ran out of the configurations budget
+    [[nodiscard]] bool isExhausted() const noexcept;
+    ~BackReferenceMatcher() = default;
+};
+
+#endif //LAB2_BACKREFERENCE_H
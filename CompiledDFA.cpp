@@ -0,0 +1,552 @@
+#include "CompiledDFA.h"
+#include <map>
+#include <unordered_map>
+#include <queue>
+#include <cstring>
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+
+// The build targets plain SSE2, pshufb is checked at run time
+__attribute__((target("ssse3")))
+static unsigned int shuffleStates(std::array<unsigned char, compiled_state::sheng_states> const* shuffles,
+                                  const unsigned char * begin, const unsigned char * end, unsigned int state) {
+    __m128i current = _mm_set1_epi8(static_cast<char>(state));
+    for (; begin != end; ++begin) {
+        __m128i row = _mm_loadu_si128(reinterpret_cast<const __m128i *>(shuffles[*begin].data()));
+        current = _mm_shuffle_epi8(row, current);
+    }
+    return _mm_cvtsi128_si32(current) & 0xFF;
+}
+#endif
+
+const char * findEscape(const char * begin, const char * end, unsigned char const* bytes, unsigned int count) noexcept {
+    if(count == 1) {
+        auto found = static_cast<const char *>(std::memchr(begin, bytes[0], end - begin));
+        return found ? found : end;
+    }
+#if defined(__SSE2__)
+    __m128i needles[compiled_state::max_escapes];
+    for (unsigned int i = 0; i < count; ++i) needles[i] = _mm_set1_epi8(static_cast<char>(bytes[i]));
+    for (; end - begin >= 16; begin += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        __m128i hits = _mm_cmpeq_epi8(block, needles[0]);
+        for (unsigned int i = 1; i < count; ++i) hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, needles[i]));
+        int mask = _mm_movemask_epi8(hits);
+        if(mask) return begin + __builtin_ctz(mask);
+    }
+#endif
+    return std::find_if(begin, end, [bytes, count](char sym) {
+        return std::find(bytes, bytes + count, static_cast<unsigned char>(sym)) != bytes + count;
+    });
+}
+
+const char * findLoopEnd(const char * begin, const char * end, unsigned char const* bytes, unsigned int count) noexcept {
+#if defined(__SSE2__)
+    __m128i needles[compiled_state::max_escapes];
+    for (unsigned int i = 0; i < count; ++i) needles[i] = _mm_set1_epi8(static_cast<char>(bytes[i]));
+    for (; end - begin >= 16; begin += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        __m128i hits = _mm_cmpeq_epi8(block, needles[0]);
+        for (unsigned int i = 1; i < count; ++i) hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, needles[i]));
+        int mask = _mm_movemask_epi8(hits) ^ 0xFFFF;
+        if(mask) return begin + __builtin_ctz(mask);
+    }
+#endif
+    return std::find_if(begin, end, [bytes, count](char sym) {
+        return std::find(bytes, bytes + count, static_cast<unsigned char>(sym)) == bytes + count;
+    });
+}
+
+void CompiledDFA::compile(DFA_Automata const& automata, unsigned int sparse_degree, unsigned long max_dense_memory,
+                          std::chrono::milliseconds max_search_time) {
+    *this = CompiledDFA();
+    if(!automata.getStart()) return;
+
+    std::vector<State *> states = {nullptr, automata.getStart()};
+    std::map<State *, unsigned int> indexes = {{automata.getStart(), 1}};
+    for (unsigned int i = 1; i < states.size(); ++i) {
+        for (auto &b : states[i]->getTransitions()) {
+            if(indexes.emplace(b->getNextState(), states.size()).second) states.push_back(b->getNextState());
+        }
+    }
+    std::vector<bool> accepting(states.size(), false);
+    for (unsigned int i = 1; i < states.size(); ++i) accepting[i] = states[i]->isFinishState();
+    build(accepting, [&](unsigned int i, std::array<unsigned int, 256> & row) {
+        if(!states[i]) return;
+        for (auto &b : states[i]->getTransitions()) {
+            auto sym_transition = dynamic_cast<SymbolTransition*>(b);
+            if(sym_transition) row[static_cast<unsigned char>(sym_transition->getSymbol())] = indexes[b->getNextState()];
+        }
+    }, sparse_degree, max_dense_memory);
+    search_->sparse_degree_ = sparse_degree;
+    search_->max_memory_ = max_dense_memory - std::min(max_dense_memory, getMemory());
+    search_->max_time_ = max_search_time;
+}
+
+// A state of the search table is the set of live states reached from every start so far,
+// the start itself included. Sets with an accepting state loop on every byte, so the scan
+// stops at the first end of a match
+std::unique_ptr<const CompiledDFA> CompiledDFA::compileSearch() const {
+    SynthesisBudget budget(compiled_state::max_search_states, search_->max_memory_, search_->max_time_);
+    // Bytes going to the same states from every state step the sets alike
+    std::vector<unsigned char> classes(256);
+    std::vector<unsigned char> representatives;
+    std::map<std::vector<unsigned int>, unsigned char> columns;
+    std::vector<unsigned int> column(getStatesCount());
+    for (unsigned int sym = 0; sym < 256; ++sym) {
+        for (unsigned int state = 0; state < column.size(); ++state) column[state] = next(state, static_cast<char>(sym));
+        auto found = columns.emplace(column, representatives.size());
+        if(found.second) representatives.push_back(sym);
+        classes[sym] = found.first->second;
+    }
+
+    struct SetHash {
+        size_t operator()(std::vector<unsigned int> const& set) const noexcept {
+            size_t hash = set.size();
+            for (auto &state : set) hash = hash * 31 + state;
+            return hash;
+        }
+    };
+    std::vector<std::vector<unsigned int>> sets = {{}, {start_}};
+    std::unordered_map<std::vector<unsigned int>, unsigned int, SetHash> indexes = {{{start_}, 1}};
+    std::vector<std::vector<unsigned int>> rows(2, std::vector<unsigned int>(representatives.size(), compiled_state::sink));
+    std::vector<bool> accepting = {false, false};
+    unsigned long memory = 0;
+    std::vector<unsigned int> moved;
+    for (unsigned int i = 1; i < sets.size(); ++i) {
+        accepting[i] = std::any_of(sets[i].begin(), sets[i].end(), [&](unsigned int state) { return flags_[state] & compiled_state::accept; });
+        if(accepting[i]) { rows[i].assign(representatives.size(), i); continue; }
+        for (unsigned int c = 0; c < representatives.size(); ++c) {
+            moved = {start_};
+            for (auto &state : sets[i]) {
+                unsigned int to = next(state, static_cast<char>(representatives[c]));
+                if(!(flags_[to] & compiled_state::dead)) moved.push_back(to);
+            }
+            std::sort(moved.begin(), moved.end());
+            moved.erase(std::unique(moved.begin(), moved.end()), moved.end());
+            auto found = indexes.emplace(moved, sets.size());
+            if(found.second) {
+                // The set is kept twice and gets a dense row in the end
+                memory += 2 * moved.size() * sizeof(unsigned int) + 256 * sizeof(unsigned int);
+                if(budget.exceeded(sets.size() + 1, memory)) return nullptr;
+                sets.push_back(moved);
+                rows.emplace_back(representatives.size(), compiled_state::sink);
+                accepting.push_back(false);
+            }
+            rows[i][c] = found.first->second;
+        }
+    }
+    auto search = std::make_unique<CompiledDFA>();
+    search->build(accepting, [&](unsigned int i, std::array<unsigned int, 256> & row) {
+        for (unsigned int sym = 0; sym < 256; ++sym) row[sym] = rows[i][classes[sym]];
+    }, search_->sparse_degree_, search_->max_memory_);
+    return search;
+}
+
+void CompiledDFA::build(std::vector<bool> const& accepting, std::function<void(unsigned int, std::array<unsigned int, 256> &)> const& fillRow,
+                        unsigned int sparse_degree, unsigned long max_dense_memory) {
+    unsigned long count = accepting.size();
+    if(sparse_degree == compiled_state::all_dense && count * 256 * sizeof(unsigned int) > max_dense_memory) {
+        sparse_degree = compiled_state::large_sparse_degree;
+    }
+
+    start_ = 1;
+    flags_.assign(count, 0);
+    if(sparse_degree != compiled_state::all_dense) rows_.assign(count, {});
+    std::array<unsigned int, 256> row;
+    std::vector<unsigned int> frequency(count, 0);
+    for (unsigned int i = 0; i < count; ++i) {
+        row.fill(compiled_state::sink);
+        fillRow(i, row);
+        flags_[i] = accepting[i] ? compiled_state::accept : 0;
+        if(rows_.empty()) { table_.insert(table_.end(), row.begin(), row.end()); continue; }
+
+        // The most common next state is the default one, the other bytes are exceptions
+        unsigned int common = row[0];
+        for (auto &next : row) {
+            if(++frequency[next] > frequency[common]) common = next;
+        }
+        for (auto &next : row) frequency[next] = 0;
+        unsigned int exceptions = 256 - std::count(row.begin(), row.end(), common);
+        Row & stored = rows_[i];
+        if(exceptions > sparse_degree) {
+            stored.dense_ = table_.size() / 256;
+            table_.insert(table_.end(), row.begin(), row.end());
+            continue;
+        }
+        stored.default_ = common;
+        stored.begin_ = exception_bytes_.size();
+        for (unsigned int sym = 0; sym < 256; ++sym) {
+            if(row[sym] == common) continue;
+            exception_bytes_.push_back(sym);
+            exception_states_.push_back(row[sym]);
+        }
+        stored.end_ = exception_bytes_.size();
+    }
+
+    // A state is dead if it reaches no accepting state and accepts forever if it reaches
+    // no other state: both come from the backward search over the table
+    std::vector<std::vector<unsigned int>> reverse(count);
+    std::vector<unsigned int> added(count, compiled_state::no_row);
+    for (unsigned int i = 0; i < count; ++i) {
+        for (unsigned int sym = 0; sym < 256; ++sym) {
+            unsigned int to = next(i, static_cast<char>(sym));
+            if(added[to] != i) { added[to] = i; reverse[to].push_back(i); }
+        }
+    }
+    auto reachable = [&](bool accepting) {
+        std::vector<bool> visited(count, false);
+        std::queue<unsigned int> queue;
+        for (unsigned int i = 0; i < count; ++i) {
+            if(bool(flags_[i] & compiled_state::accept) == accepting) { visited[i] = true; queue.push(i); }
+        }
+        while (!queue.empty()) {
+            unsigned int working = queue.front();
+            queue.pop();
+            for (auto &i : reverse[working]) {
+                if(!visited[i]) { visited[i] = true; queue.push(i); }
+            }
+        }
+        return visited;
+    };
+    auto to_accept = reachable(true);
+    auto to_reject = reachable(false);
+    for (unsigned int i = 0; i < count; ++i) {
+        if(!to_accept[i]) flags_[i] |= compiled_state::dead;
+        if(!to_reject[i]) flags_[i] |= compiled_state::accept_forever;
+    }
+
+    // Self loops on all bytes but a few ones, or on a few bytes only like the states of 'x...'
+    escapes_.assign(count, {{}, 0, false});
+    for (unsigned int i = 0; i < count; ++i) {
+        if(flags_[i] & (compiled_state::dead | compiled_state::accept_forever)) continue;
+        Escapes escapes = {{}, 0, false};
+        Escapes loops = {{}, 0, true};
+        for (unsigned int sym = 0; sym < 256; ++sym) {
+            Escapes & kind = next(i, static_cast<char>(sym)) == i ? loops : escapes;
+            if(kind.count_ < compiled_state::max_escapes) kind.bytes_[kind.count_] = sym;
+            ++kind.count_;
+        }
+        if(escapes.count_ && escapes.count_ <= compiled_state::max_escapes) escapes_[i] = escapes;
+        else if(loops.count_ && loops.count_ <= compiled_state::max_escapes) escapes_[i] = loops;
+        else continue;
+        flags_[i] |= compiled_state::accelerated;
+    }
+
+    // States left by a few bytes only skip faster than shuffles step
+    if(count > compiled_state::sheng_states) return;
+    for (unsigned int i = 0; i < count; ++i) {
+        if((flags_[i] & compiled_state::accelerated) && !escapes_[i].loop_) return;
+    }
+    shuffles_.assign(256, {});
+    for (unsigned int sym = 0; sym < 256; ++sym) {
+        for (unsigned int i = 0; i < count; ++i) shuffles_[sym][i] = next(i, static_cast<char>(sym));
+    }
+}
+
+void CompiledDFA::renumber(std::vector<unsigned int> const& order) {
+    std::vector<unsigned int> id(order.size());
+    for (unsigned int i = 0; i < order.size(); ++i) id[order[i]] = i;
+
+    CompiledDFA result;
+    result.start_ = id[start_];
+    result.search_ = search_;
+    result.flags_.resize(order.size());
+    result.escapes_.resize(order.size());
+    if(!rows_.empty()) result.rows_.resize(order.size());
+    for (unsigned int i = 0; i < order.size(); ++i) {
+        unsigned int old = order[i];
+        result.flags_[i] = flags_[old];
+        result.escapes_[i] = escapes_[old];
+        unsigned int dense = rows_.empty() ? old : rows_[old].dense_;
+        if(!rows_.empty() && dense != compiled_state::no_row) result.rows_[i].dense_ = result.table_.size() / 256;
+        if(dense != compiled_state::no_row) {
+            for (unsigned int sym = 0; sym < 256; ++sym) result.table_.push_back(id[table_[dense * 256 + sym]]);
+            continue;
+        }
+        Row const& row = rows_[old];
+        Row & moved = result.rows_[i];
+        moved.default_ = id[row.default_];
+        moved.begin_ = result.exception_bytes_.size();
+        for (unsigned int e = row.begin_; e < row.end_; ++e) {
+            result.exception_bytes_.push_back(exception_bytes_[e]);
+            result.exception_states_.push_back(id[exception_states_[e]]);
+        }
+        moved.end_ = result.exception_bytes_.size();
+    }
+    if(!shuffles_.empty()) {
+        result.shuffles_.assign(256, {});
+        for (unsigned int sym = 0; sym < 256; ++sym) {
+            for (unsigned int i = 0; i < order.size(); ++i) result.shuffles_[sym][i] = result.next(i, static_cast<char>(sym));
+        }
+    }
+    *this = std::move(result);
+}
+
+void CompiledDFA::reorderByBreadth() {
+    if(isEmpty()) return;
+    std::vector<unsigned int> order = {compiled_state::sink, start_};
+    std::vector<bool> visited(getStatesCount(), false);
+    visited[compiled_state::sink] = visited[start_] = true;
+    for (unsigned int i = 1; i < order.size(); ++i) {
+        for (unsigned int sym = 0; sym < 256; ++sym) {
+            unsigned int to = next(order[i], static_cast<char>(sym));
+            if(!visited[to]) { visited[to] = true; order.push_back(to); }
+        }
+    }
+    for (unsigned int i = 0; i < getStatesCount(); ++i) {
+        if(!visited[i]) order.push_back(i);
+    }
+    renumber(order);
+}
+
+void CompiledDFA::reorderByProfile(std::span<const std::string_view> samples) {
+    if(isEmpty()) return;
+    reorderByBreadth();
+    std::vector<unsigned long> visits(getStatesCount(), 0);
+    constexpr compiled_state::flags finished = compiled_state::dead | compiled_state::accept_forever;
+    for (auto &str : samples) {
+        unsigned int state = start_;
+        for (auto &sym : str) {
+            ++visits[state];
+            if(flags_[state] & finished) break;
+            state = next(state, sym);
+        }
+        ++visits[state];
+    }
+    std::vector<unsigned int> order(getStatesCount());
+    for (unsigned int i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin() + 1, order.end(), [&](unsigned int left, unsigned int right) { return visits[left] > visits[right]; });
+    renumber(order);
+}
+
+bool CompiledDFA::hasShuffles() const noexcept { return !shuffles_.empty(); }
+
+// Dead and accept-forever states never leave their kind, so they are checked once a block
+bool CompiledDFA::matchSheng(std::string_view str) const {
+    constexpr unsigned long block = 64;
+    constexpr compiled_state::flags finished = compiled_state::dead | compiled_state::accept_forever;
+    auto begin = reinterpret_cast<const unsigned char *>(str.data());
+    auto end = begin + str.size();
+    unsigned int state = start_;
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool ssse3 = __builtin_cpu_supports("ssse3");
+#else
+    constexpr bool ssse3 = false;
+#endif
+    while (begin != end && !(flags_[state] & finished)) {
+        auto stop = end - begin > static_cast<long>(block) ? begin + block : end;
+#if defined(__x86_64__) || defined(__i386__)
+        if(ssse3) {
+            state = shuffleStates(shuffles_.data(), begin, stop, state);
+            begin = stop;
+            continue;
+        }
+#endif
+        for (; begin != stop; ++begin) state = shuffles_[*begin][state];
+    }
+    return flags_[state] & compiled_state::accept;
+}
+
+unsigned long CompiledDFA::skip(std::string_view str, unsigned long from, unsigned int state) const noexcept {
+    Escapes const& escapes = escapes_[state];
+    const char * end = str.data() + str.size();
+    if(escapes.loop_) {
+        // Runs of loop bytes are often short, the first byte is checked before the search
+        if(from == str.size() || next(state, str[from]) != state) return from;
+        return findLoopEnd(str.data() + from, end, escapes.bytes_, escapes.count_) - str.data();
+    }
+    return findEscape(str.data() + from, end, escapes.bytes_, escapes.count_) - str.data();
+}
+
+unsigned int CompiledDFA::getAcceleratedCount() const noexcept {
+    return std::count_if(flags_.begin(), flags_.end(), [](compiled_state::flags flags) { return flags & compiled_state::accelerated; });
+}
+
+bool CompiledDFA::isEmpty() const noexcept { return flags_.empty(); }
+
+unsigned int CompiledDFA::getStatesCount() const noexcept { return flags_.size(); }
+
+unsigned int CompiledDFA::getStart() const noexcept { return start_; }
+
+unsigned int CompiledDFA::next(unsigned int state, char sym) const noexcept {
+    auto byte = static_cast<unsigned char>(sym);
+    if(rows_.empty()) return table_[state * 256 + byte];
+    Row const& row = rows_[state];
+    if(row.dense_ != compiled_state::no_row) return table_[row.dense_ * 256 + byte];
+    auto begin = exception_bytes_.begin() + row.begin_;
+    auto end = exception_bytes_.begin() + row.end_;
+    auto found = std::lower_bound(begin, end, byte);
+    if(found == end || *found != byte) return row.default_;
+    return exception_states_[found - exception_bytes_.begin()];
+}
+
+unsigned long CompiledDFA::getMemory() const noexcept {
+    return table_.size() * sizeof(unsigned int) + rows_.size() * sizeof(Row) + exception_bytes_.size() * (1 + sizeof(unsigned int)) +
+           flags_.size() * (sizeof(compiled_state::flags) + sizeof(Escapes)) + shuffles_.size() * compiled_state::sheng_states;
+}
+
+compiled_state::flags CompiledDFA::getFlags(unsigned int state) const noexcept { return flags_[state]; }
+
+bool CompiledDFA::match(std::string_view str) const {
+    if(isEmpty()) return false;
+    if(hasShuffles()) return matchSheng(str);
+    unsigned int state = start_;
+    for (unsigned long i = 0; i < str.size(); ++i) {
+        if(flags_[state] & (compiled_state::dead | compiled_state::accept_forever)) break;
+        if(flags_[state] & compiled_state::accelerated) {
+            i = skip(str, i, state);
+            if(i == str.size()) break;
+        }
+        state = next(state, str[i]);
+    }
+    return flags_[state] & compiled_state::accept;
+}
+
+void CompiledDFA::matchBatch(std::span<const std::string_view> strs, std::vector<bool> &results) const {
+    results.assign(strs.size(), false);
+    if(isEmpty()) return;
+
+    struct Lane {
+        unsigned long str_;
+        unsigned long pos_;
+        unsigned int state_;
+    };
+    Lane lanes[compiled_state::batch_lanes];
+    unsigned int active = 0;
+    unsigned long taken = 0;
+    auto fill = [&](Lane & lane) {
+        if(taken == strs.size()) return false;
+        lane = {taken++, 0, start_};
+        return true;
+    };
+    while (active < compiled_state::batch_lanes && fill(lanes[active])) ++active;
+
+    constexpr compiled_state::flags finished = compiled_state::dead | compiled_state::accept_forever;
+    while (active) {
+        // A finished lane without a string to take is replaced with the last one, which is stepped next
+        for (unsigned int i = 0; i < active; ) {
+            Lane & lane = lanes[i];
+            std::string_view str = strs[lane.str_];
+            if(lane.pos_ < str.size() && !(flags_[lane.state_] & finished)) {
+                lane.state_ = next(lane.state_, str[lane.pos_++]);
+                ++i;
+                continue;
+            }
+            results[lane.str_] = flags_[lane.state_] & compiled_state::accept;
+            if(fill(lane)) ++i;
+            else lane = lanes[--active];
+        }
+    }
+}
+
+bool CompiledDFA::matchPrefix(std::string_view str) const {
+    if(isEmpty()) return false;
+    unsigned int state = start_;
+    for (unsigned long i = 0; i < str.size(); ++i) {
+        if(flags_[state] & (compiled_state::dead | compiled_state::accept)) break;
+        if(flags_[state] & compiled_state::accelerated) {
+            i = skip(str, i, state);
+            if(i == str.size()) break;
+        }
+        state = next(state, str[i]);
+    }
+    return flags_[state] & compiled_state::accept;
+}
+
+bool CompiledDFA::search(std::string_view str) const {
+    if(isEmpty() || (flags_[start_] & compiled_state::dead)) return false;
+    std::call_once(search_->built_, [this]() { search_->table_ = compileSearch(); });
+    if(search_->table_) return search_->table_->match(str);
+
+    // The live states of the matches started so far are stepped together, a new one starts at every byte
+    std::vector<unsigned int> current = {start_};
+    std::vector<unsigned int> following;
+    std::vector<unsigned long> added(getStatesCount(), static_cast<unsigned long>(-1));
+    for (unsigned long i = 0; ; ++i) {
+        for (auto &state : current) {
+            if(flags_[state] & compiled_state::accept) return true;
+        }
+        if(i == str.size()) return false;
+        following = {start_};
+        added[start_] = i;
+        for (auto &state : current) {
+            unsigned int to = next(state, str[i]);
+            if(!(flags_[to] & compiled_state::dead) && added[to] != i) { added[to] = i; following.push_back(to); }
+        }
+        current.swap(following);
+    }
+}
+
+tag_type::tag_value CompiledDFA::longestMatch(std::string_view str, tag_type::tag_value from) const {
+    if(isEmpty()) return tag_type::empty;
+    unsigned int state = start_;
+    tag_type::tag_value last_accept = tag_type::empty;
+    for (unsigned long i = from; ; ++i) {
+        if(flags_[state] & compiled_state::accept_forever) return str.size();
+        // An accepting state accepts at every position it loops over
+        if(flags_[state] & compiled_state::accelerated) i = skip(str, i, state);
+        if(flags_[state] & compiled_state::accept) last_accept = i;
+        if(i == str.size() || (flags_[state] & compiled_state::dead)) break;
+        state = next(state, str[i]);
+    }
+    return last_accept;
+}
+
+void CompiledDFA::matchEnds(std::string_view str, tag_type::tag_value from, std::vector<tag_type::tag_value> &ends) const {
+    ends.clear();
+    if(isEmpty()) return;
+    unsigned int state = start_;
+    for (unsigned long i = from; ; ++i) {
+        if(flags_[state] & compiled_state::accept_forever) {
+            for (unsigned long end = i; end <= str.size(); ++end) ends.push_back(end);
+            return;
+        }
+        if(flags_[state] & compiled_state::accelerated) {
+            unsigned long escape = skip(str, i, state);
+            if(flags_[state] & compiled_state::accept) {
+                for (; i < escape; ++i) ends.push_back(i);
+            }
+            i = escape;
+        }
+        if(flags_[state] & compiled_state::accept) ends.push_back(i);
+        if(i == str.size() || (flags_[state] & compiled_state::dead)) return;
+        state = next(state, str[i]);
+    }
+}
+
+void CompiledDFA::matchStarts(std::string_view str, std::vector<tag_type::tag_value> &starts) const {
+    starts.clear();
+    if(isEmpty() || (flags_[start_] & compiled_state::dead)) return;
+
+    // Live states at position i are live[offsets[i], offsets[i + 1])
+    std::vector<unsigned int> live = {start_};
+    std::vector<unsigned long> offsets = {0, 1};
+    std::vector<unsigned long> added(getStatesCount(), static_cast<unsigned long>(-1));
+    for (unsigned long i = 0; i < str.size(); ++i) {
+        added[start_] = i;
+        live.push_back(start_);
+        for (unsigned long k = offsets[i]; k < offsets[i + 1]; ++k) {
+            unsigned int to = next(live[k], str[i]);
+            if(!(flags_[to] & compiled_state::dead) && added[to] != i) { added[to] = i; live.push_back(to); }
+        }
+        offsets.push_back(live.size());
+    }
+
+    // 'reaches' marks the states of the next position with an accept ahead, 'reaching' the ones of this position
+    std::vector<unsigned long> reaches(getStatesCount(), static_cast<unsigned long>(-1));
+    std::vector<unsigned long> reaching(getStatesCount(), static_cast<unsigned long>(-1));
+    for (unsigned long i = str.size() + 1; i-- > 0; ) {
+        for (unsigned long k = offsets[i]; k < offsets[i + 1]; ++k) {
+            unsigned int state = live[k];
+            if((flags_[state] & compiled_state::accept) || (i < str.size() && reaches[next(state, str[i])] == i + 1)) reaching[state] = i;
+        }
+        if(reaching[start_] == i) starts.push_back(i);
+        reaches.swap(reaching);
+    }
+    std::reverse(starts.begin(), starts.end());
+}
@@ -0,0 +1,144 @@
+#ifndef LAB2_COMPILEDDFA_H
+#define LAB2_COMPILEDDFA_H
+
+#include "DFA.h"
+#include "TaggedDFA.h"
+#include <vector>
+#include <string_view>
+#include <span>
+#include <array>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <chrono>
+
+namespace compiled_state {
+    typedef unsigned char flags;
+    inline constexpr flags accept = 1;
+    // No accepting state is reachable, the outcome is a reject
+    inline constexpr flags dead = 2;
+    // Every reachable state is accepting, the outcome is an accept
+    inline constexpr flags accept_forever = 4;
+    // All bytes but a few escape ones loop back to the state, or a few bytes loop back and
+    // all others leave it: the scan skips to the next byte leaving the state
+    inline constexpr flags accelerated = 8;
+    // The sink state of missing transitions
+    inline constexpr unsigned int sink = 0;
+    // Accelerated states have at most this count of escape or loop bytes
+    inline constexpr unsigned int max_escapes = 3;
+    // Strings walked in lockstep by matchBatch
+    inline constexpr unsigned int batch_lanes = 8;
+    // Tables with at most this count of states, the sink included, are run by shuffles
+    inline constexpr unsigned int sheng_states = 16;
+    // Every state has a dense row of 256 next states
+    inline constexpr unsigned int all_dense = 0;
+    // Sparse degree of the tables whose dense rows are over the memory limit
+    inline constexpr unsigned int large_sparse_degree = 32;
+    inline constexpr unsigned int no_row = static_cast<unsigned int>(-1);
+    // Search tables over this count of states are not built, the search steps sets of states
+    inline constexpr unsigned int max_search_states = 4096;
+}
+
+// First byte of [begin, end) that is one of 'bytes', memchr for one byte and SSE2 for more
+[[nodiscard]] const char * findEscape(const char * begin, const char * end, unsigned char const* bytes, unsigned int count) noexcept;
+// First byte of [begin, end) that is none of 'bytes'
+[[nodiscard]] const char * findLoopEnd(const char * begin, const char * end, unsigned char const* bytes, unsigned int count) noexcept;
+
+// DFA as a flat table of 256 next states per state, state 0 is the dead sink.
+// Scanning stops as soon as a dead or an accept-forever state fixes the outcome,
+// accelerated states skip to the next escape byte instead of stepping through the table.
+// States with few bytes leaving their most common next state may keep these bytes only
+class CompiledDFA {
+    // 'loop_' tells the bytes keep the state, otherwise they leave it
+    struct Escapes {
+        unsigned char bytes_[compiled_state::max_escapes];
+        unsigned int count_;
+        bool loop_;
+    };
+
+    // Sorted exception bytes [begin_, end_) with their next states, the other bytes go to
+    // 'default_'. States with a dense row in the table have its index in 'dense_'
+    struct Row {
+        unsigned int dense_ = compiled_state::no_row;
+        unsigned int default_ = compiled_state::sink;
+        unsigned int begin_ = 0;
+        unsigned int end_ = 0;
+    };
+
+    std::vector<unsigned int> table_;
+    // Empty when every state has a dense row
+    std::vector<Row> rows_;
+    std::vector<unsigned char> exception_bytes_;
+    std::vector<unsigned int> exception_states_;
+    std::vector<compiled_state::flags> flags_;
+    std::vector<Escapes> escapes_;
+    // Sheng table: the row of a byte holds the next state of every state, so one byte
+    // is one shuffle of the row by the current state. Empty for bigger tables
+    std::vector<std::array<unsigned char, compiled_state::sheng_states>> shuffles_;
+    unsigned int start_ = compiled_state::sink;
+    // Table of the unanchored search with the limits of its build, made by the first search and
+    // shared by the copies. Empty when the build runs over the limits
+    struct SearchTable {
+        std::once_flag built_;
+        std::unique_ptr<const CompiledDFA> table_;
+        unsigned int sparse_degree_ = compiled_state::all_dense;
+        unsigned long max_memory_ = static_cast<unsigned long>(-1);
+        std::chrono::milliseconds max_time_ = std::chrono::milliseconds::max();
+    };
+
+    std::shared_ptr<SearchTable> search_ = std::make_shared<SearchTable>();
+
+    // Rows, flags and acceleration of the states, 'fillRow' sets the next states of a state
+    // over a row of sinks. State 1 is the start
+    void build(std::vector<bool> const& accepting, std::function<void(unsigned int, std::array<unsigned int, 256> &)> const& fillRow,
+               unsigned int sparse_degree, unsigned long max_dense_memory);
+    // Subset construction of the search table over the classes of bytes with equal columns,
+    // nullptr past compiled_state::max_search_states, the memory or the time of the limits
+    [[nodiscard]] std::unique_ptr<const CompiledDFA> compileSearch() const;
+    [[nodiscard]] bool matchSheng(std::string_view str) const;
+    // State 'order[i]' becomes state i, the sink stays first
+    void renumber(std::vector<unsigned int> const& order);
+    // Position of the first byte from 'from' leaving the accelerated state
+    [[nodiscard]] unsigned long skip(std::string_view str, unsigned long from, unsigned int state) const noexcept;
+public:
+    CompiledDFA() = default;
+    // States leaving their most common next state by at most 'sparse_degree' bytes keep these
+    // bytes only: less memory for a search per byte. Dense tables bigger than 'max_dense_memory'
+    // bytes get compiled_state::large_sparse_degree. The search table gets the memory left by the
+    // table and 'max_search_time' when the first search builds it
+    void compile(DFA_Automata const& automata, unsigned int sparse_degree = compiled_state::all_dense,
+                 unsigned long max_dense_memory = static_cast<unsigned long>(-1),
+                 std::chrono::milliseconds max_search_time = std::chrono::milliseconds::max());
+    [[nodiscard]] bool isEmpty() const noexcept;
+    [[nodiscard]] unsigned int getStatesCount() const noexcept;
+    [[nodiscard]] unsigned int getStart() const noexcept;
+    [[nodiscard]] unsigned int next(unsigned int state, char sym) const noexcept;
+    [[nodiscard]] compiled_state::flags getFlags(unsigned int state) const noexcept;
+    [[nodiscard]] unsigned int getAcceleratedCount() const noexcept;
+    [[nodiscard]] bool hasShuffles() const noexcept;
+    // Bytes taken by the tables, the search table aside
+    [[nodiscard]] unsigned long getMemory() const noexcept;
+    // Breadth-first numbering from the start by increasing bytes, near states share cache lines
+    void reorderByBreadth();
+    // States visited more often by the samples get smaller numbers, ties keep the breadth-first order
+    void reorderByProfile(std::span<const std::string_view> samples);
+    [[nodiscard]] bool match(std::string_view str) const;
+    // match of every string: 'batch_lanes' strings are walked at once so the table loads
+    // of different strings overlap, a finished lane takes the next string
+    void matchBatch(std::span<const std::string_view> strs, std::vector<bool> & results) const;
+    // Some prefix of the string is in the language
+    [[nodiscard]] bool matchPrefix(std::string_view str) const;
+    // Some substring of the string is in the language, found by one scan of the search table.
+    // The first call builds the table, safe from several threads
+    [[nodiscard]] bool search(std::string_view str) const;
+    // End of the longest match starting at 'from' or tag_type::empty
+    [[nodiscard]] tag_type::tag_value longestMatch(std::string_view str, tag_type::tag_value from) const;
+    // Every end of a match starting at 'from' in increasing order
+    void matchEnds(std::string_view str, tag_type::tag_value from, std::vector<tag_type::tag_value> & ends) const;
+    // Every start of a match in increasing order: one pass forward over the live states of all
+    // the starts and one pass back over the ones reaching an accept
+    void matchStarts(std::string_view str, std::vector<tag_type::tag_value> & starts) const;
+    ~CompiledDFA() = default;
+};
+
+#endif //LAB2_COMPILEDDFA_H
@@ -0,0 +1,154 @@
+#include "CountingNFA.h"
+#include <map>
+#include <algorithm>
+
+// CountingSet
+
+CountingSet::CountingSet(unsigned long max) : max_(max) {}
+
+void CountingSet::insert() {
+    if(inserted_.empty() || inserted_.back() != step_) inserted_.push_back(step_);
+}
+
+void CountingSet::increment() {
+    ++step_;
+    while (!inserted_.empty() && step_ - inserted_.front() > max_) inserted_.pop_front();
+}
+
+void CountingSet::clear() noexcept { inserted_.clear(); }
+
+bool CountingSet::empty() const noexcept { return inserted_.empty(); }
+
+bool CountingSet::hasMax() const noexcept { return !inserted_.empty() && step_ - inserted_.front() == max_; }
+
+// CountingNFA_Automata
+
+void CountingNFA_Automata::synthesisFromNFA(const NFA_Automata *nfa_auto) {
+    *this = CountingNFA_Automata();
+    std::vector<State*> states;
+    std::map<State*, unsigned int> indexes;
+    auto index = [&](State * state) {
+        auto found = indexes.find(state);
+        if(found != indexes.end()) return found->second;
+        unsigned int id = states.size();
+        indexes[state] = id;
+        states.push_back(state);
+        return id;
+    };
+
+    start_ = index(nfa_auto->getBeginConnector());
+    end_ = index(nfa_auto->getEndConnector());
+    for (unsigned int i = 0; i < states.size(); ++i) {
+        CountingNFAState state;
+        auto counting = dynamic_cast<CountingState*>(states[i]);
+        if(counting) {
+            state.counter_ = counters_.size();
+            counters_.push_back({i, counting->getSymbols(), CountingSet(counting->getCount())});
+        }
+        for (auto &b : states[i]->getTransitions()) {
+            auto sym_transition = dynamic_cast<SymbolTransition*>(b);
+            auto class_transition = dynamic_cast<SymbolClassTransition*>(b);
+            if(sym_transition) state.symbols_.emplace_back(sym_transition->getSymbol(), index(b->getNextState()));
+            else if(class_transition) state.classes_.emplace_back(class_transition->getSymbols(), index(b->getNextState()));
+            else if(compaireTransition<EpsilonTransition>(b)) state.epsilons_.push_back(index(b->getNextState()));
+        }
+        states_.push_back(std::move(state));
+    }
+    visited_.assign(states_.size(), 0);
+}
+
+bool CountingNFA_Automata::isEmpty() const noexcept { return states_.empty(); }
+
+unsigned long CountingNFA_Automata::getCountersCount() const noexcept { return counters_.size(); }
+
+// Entering a counting state starts a new counter, its epsilons are followed by 'step' only
+void CountingNFA_Automata::closure() {
+    ++generation_;
+    active_.clear();
+    stack_ = seeds_;
+    while (!stack_.empty()) {
+        unsigned int state = stack_.back();
+        stack_.pop_back();
+        if(visited_[state] == generation_) continue;
+        visited_[state] = generation_;
+
+        CountingNFAState const& working = states_[state];
+        if(working.counter_ != tag_type::none) {
+            counters_[working.counter_].values_.insert();
+            continue;
+        }
+        if(!working.symbols_.empty() || !working.classes_.empty() || state == end_) active_.push_back(state);
+        for (auto &i : working.epsilons_) stack_.push_back(i);
+    }
+}
+
+void CountingNFA_Automata::startStates() {
+    for (auto &i : counters_) i.values_.clear();
+    seeds_ = {start_};
+    closure();
+}
+
+void CountingNFA_Automata::step(char sym, bool restart) {
+    seeds_.clear();
+    if(restart) seeds_.push_back(start_);
+    for (auto &i : active_) {
+        for (auto &b : states_[i].symbols_) {
+            if(b.first == sym) seeds_.push_back(b.second);
+        }
+        for (auto &b : states_[i].classes_) {
+            if(b.first.test(static_cast<unsigned char>(sym))) seeds_.push_back(b.second);
+        }
+    }
+    for (auto &i : counters_) {
+        if(i.values_.empty()) continue;
+        if(!i.symbols_.test(static_cast<unsigned char>(sym))) { i.values_.clear(); continue; }
+        i.values_.increment();
+        if(i.values_.hasMax()) {
+            for (auto &b : states_[i.state_].epsilons_) seeds_.push_back(b);
+        }
+    }
+    closure();
+}
+
+bool CountingNFA_Automata::isAccept() const {
+    for (auto &i : active_) {
+        if(i == end_) return true;
+    }
+    return false;
+}
+
+bool CountingNFA_Automata::isDead() const {
+    return active_.empty() && std::all_of(counters_.begin(), counters_.end(), [](Counter const& counter) { return counter.values_.empty(); });
+}
+
+bool CountingNFA_Automata::match(std::string_view str) {
+    if(isEmpty()) return false;
+    startStates();
+    for (auto &i : str) {
+        step(i);
+        if(isDead()) return false;
+    }
+    return isAccept();
+}
+
+tag_type::tag_value CountingNFA_Automata::longestMatch(std::string_view str, tag_type::tag_value from) {
+    if(isEmpty()) return tag_type::empty;
+    startStates();
+    tag_type::tag_value last_accept = isAccept() ? from : tag_type::empty;
+    for (unsigned long i = from; i < str.size(); ++i) {
+        step(str[i]);
+        if(isAccept()) last_accept = i + 1;
+        if(isDead()) break;
+    }
+    return last_accept;
+}
+
+bool CountingNFA_Automata::search(std::string_view str) {
+    if(isEmpty()) return false;
+    startStates();
+    for (auto &i : str) {
+        if(isAccept()) return true;
+        step(i, true);
+    }
+    return isAccept();
+}
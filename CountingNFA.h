@@ -0,0 +1,72 @@
+#ifndef LAB2_COUNTINGNFA_H
+#define LAB2_COUNTINGNFA_H
+
+#include "NFA.h"
+#include "TaggedDFA.h"
+#include <vector>
+#include <deque>
+#include <bitset>
+#include <string_view>
+
+// Values of the counters of one counting state. All the values are incremented together,
+// so a value is stored as the step it was inserted on: increment is O(1) and
+// the values are ordered from the largest one
+class CountingSet {
+    std::deque<unsigned long> inserted_;
+    unsigned long step_ = 0;
+    unsigned long max_ = 0;
+public:
+    CountingSet() = default;
+    explicit CountingSet(unsigned long max);
+    void insert();
+    void increment();
+    void clear() noexcept;
+    [[nodiscard]] bool empty() const noexcept;
+    [[nodiscard]] bool hasMax() const noexcept;
+};
+
+// NFA simulation where a counting state keeps one set of counters instead of 'count' copies
+// of the repeated symbol: memory of the automata doesn't depend on the counts
+class CountingNFA_Automata {
+    struct CountingNFAState {
+        std::vector<std::pair<char, unsigned int>> symbols_;
+        std::vector<std::pair<std::bitset<256>, unsigned int>> classes_;
+        std::vector<unsigned int> epsilons_;
+        unsigned int counter_ = tag_type::none;
+    };
+    struct Counter {
+        unsigned int state_;
+        std::bitset<256> symbols_;
+        CountingSet values_;
+    };
+
+    std::vector<CountingNFAState> states_;
+    std::vector<Counter> counters_;
+    unsigned int start_ = 0;
+    unsigned int end_ = 0;
+    std::vector<unsigned int> active_;
+    std::vector<unsigned int> seeds_;
+    std::vector<unsigned int> stack_;
+    std::vector<unsigned long> visited_;
+    unsigned long generation_ = 0;
+
+    void closure();
+    void startStates();
+    // With 'restart' a new match starts after the symbol as well
+    void step(char sym, bool restart = false);
+    [[nodiscard]] bool isAccept() const;
+    [[nodiscard]] bool isDead() const;
+public:
+    CountingNFA_Automata() = default;
+    void synthesisFromNFA(const NFA_Automata * nfa_auto);
+    [[nodiscard]] bool isEmpty() const noexcept;
+    [[nodiscard]] unsigned long getCountersCount() const noexcept;
+    [[nodiscard]] bool match(std::string_view str);
+    // End of the longest match starting at 'from' or tag_type::empty
+    [[nodiscard]] tag_type::tag_value longestMatch(std::string_view str, tag_type::tag_value from);
+    // Some substring of the string is in the language, the counters keep the values of every start
+    [[nodiscard]] bool search(std::string_view str);
+    ~CountingNFA_Automata() = default;
+};
+
+#endif //LAB2_COUNTINGNFA_H
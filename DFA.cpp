@@ -2,6 +2,13 @@
 #include <set>
 #include <stack>
 #include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
 
 bool StatesGroup::operator==(StatesGroup const& state_group) const {
     return states_ == state_group.states_;
@@ -30,17 +37,43 @@ std::pair<State *, bool> StatesGroupCollector::findState(const StatesGroup &stat
 }
 
 std::pair<const StatesGroup &, bool> StatesGroupCollector::findStatesGroup(State *state) {
-    for (auto &i : collector_) {
-        if(i.second == state) return {i.first, true};
-    }
-    return {StatesGroup(), false};
+    static const StatesGroup empty;
+    auto res = groups_.find(state);
+    if(res != groups_.end()) return {*res->second, true};
+    return {empty, false};
 }
 
 std::pair<State *, bool> StatesGroupCollector::insert(const StatesGroup &states_group, State *state) {
     auto res = collector_.insert({states_group, state});
+    if(res.second) groups_[state] = &res.first->first;
     return {state, res.second};
 }
 
+unsigned long StatesGroupCollector::size() const noexcept { return collector_.size(); }
+
+void StatesGroupCollector::deleteStates() {
+    for (auto &i : collector_) delete i.second;
+    collector_.clear();
+    groups_.clear();
+}
+
+SynthesisBudget::SynthesisBudget(unsigned long max_states, unsigned long max_memory, std::chrono::milliseconds max_time) :
+        max_states_(max_states), max_memory_(max_memory) {
+    auto now = std::chrono::steady_clock::now();
+    if(max_time < std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::time_point::max() - now)) {
+        deadline_ = now + max_time;
+    }
+}
+
+bool SynthesisBudget::exceeded(unsigned long states, unsigned long memory) const {
+    if(states > max_states_ || memory > max_memory_) return true;
+    return deadline_ != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() > deadline_;
+}
+
+unsigned long SynthesisBudget::getMaxStates() const noexcept { return max_states_; }
+
+unsigned long SynthesisBudget::getMaxMemory() const noexcept { return max_memory_; }
+
 DFA_Automata::DFA_Automata(State *start) { start_ = start; }
 
 StatesGroup DFA_Automata::order_for_epsilon(State *state) {
@@ -84,20 +117,34 @@ StatesGroup DFA_Automata::order_for_epsilon(std::vector<State*> const& states) {
     return StatesGroup(visited);
 }
 
+// Future of a set depends on the states reading symbols, the end state and the flags only
+StatesGroup DFA_Automata::kernel(StatesGroup const& states_group, State * endState) {
+    std::set<State *> kernel;
+    for (auto &i : states_group.getStates()) {
+        bool important = i == endState || i->isFinishState() || dynamic_cast<CaptureGroupState*>(i);
+        for (auto &b : i->getTransitions()) {
+            if(important) break;
+            important = compaireTransition<SymbolTransition>(b) || compaireTransition<SymbolClassTransition>(b);
+        }
+        if(important) kernel.insert(i);
+    }
+    return StatesGroup(kernel);
+}
+
+// States of position automatas are accepting by the flag, they have no end connector
 [[nodiscard]] State* DFA_Automata::createState(StatesGroup const& states_group, State * endState) {
     bool hasCaptureGroups = false;
+    bool isFinish = states_group.hasEndState(endState);
     for (auto &i : states_group.getStates()) {
-        if(dynamic_cast<CaptureGroupState*>(i)) {
-            hasCaptureGroups = true;
-            break;
-        }
+        if(dynamic_cast<CaptureGroupState*>(i)) hasCaptureGroups = true;
+        if(i->isFinishState()) isFinish = true;
     }
 
-    if(!hasCaptureGroups) { return new State(states_group.hasEndState(endState)); }
+    if(!hasCaptureGroups) { return new State(isFinish); }
 
     auto state = new CaptureGroupState();
+    if(isFinish) state->finishState();
     for (auto &i : states_group.getStates()) {
-        if(i == endState) state->finishState();
         auto capt_state =  dynamic_cast<CaptureGroupState*>(i);
         if(capt_state) {
             state->addInfo(capt_state->getCaptureGroupName(), capt_state->isStart(), capt_state->isFinish());
@@ -107,23 +154,46 @@ StatesGroup DFA_Automata::order_for_epsilon(std::vector<State*> const& states) {
     return state;
 }
 
-std::map<char, std::vector<State*>> DFA_Automata::single_order_for_symbol(State *determenistic_state, StatesGroupCollector & collector) {
+// Moves are keyed by the first symbol of the byte class, other members go the same way
+std::map<char, std::vector<State*>> DFA_Automata::moves(StatesGroup const& states_group, ByteClasses const& byte_classes) {
     std::map<char, std::vector<State*>> visited;
+    std::vector<unsigned int> edge_classes;
+    for (auto &i : states_group.getStates()) {
+        for (auto &b : i->getTransitions()) {
+            byte_classes.transitionClasses(b, edge_classes);
+            for (auto &c : edge_classes) {
+                visited[static_cast<char>(byte_classes.members(c).front())].push_back(b->getNextState());
+            }
+        }
+    }
+    return visited;
+}
 
+std::map<char, std::vector<State*>> DFA_Automata::single_order_for_symbol(State *determenistic_state, StatesGroupCollector & collector, ByteClasses const& byte_classes) {
     auto group = collector.findStatesGroup(determenistic_state);
-    if(group.second) {
-        for (auto &i : group.first.getStates()) {
-            for (auto &b : i->getTransitions()) {
-                if(compaireTransition<SymbolTransition>(b)) {
-                    auto sym_transition = dynamic_cast<SymbolTransition*>(b);
-                    visited[sym_transition->getSymbol()].push_back(sym_transition->getNextState());
+    if(group.second) return moves(group.first, byte_classes);
+
+    throw std::logic_error("DFA Error");
+}
+
+// The state loops on 'sym' if some NFA state of its set goes back to itself through one more state
+void DFA_Automata::markCycle(State *working, StatesGroup const& states_group, char sym) {
+    for (auto &b: states_group.getStates()) {
+        for (auto &c : b->getTransitions()) {
+            auto sym_trans = dynamic_cast<SymbolTransition*>(c);
+            auto class_trans = dynamic_cast<SymbolClassTransition*>(c);
+            if(sym_trans || class_trans) {
+                if(sym_trans ? sym_trans->getSymbol() == sym : class_trans->hasSymbol(sym)) {
+                    auto next = c->getNextState();
+                    for (auto &d : next->getTransitions()) {
+                        if(d->getNextState() == b) {
+                            working->cycle();
+                        }
+                    }
                 }
             }
         }
-        return visited;
     }
-
-    throw std::logic_error("DFA Error");
 }
 
 State * DFA_Automata::addTransitionNewState(State *to_state, State *out_state, char transitionSymbol) {
@@ -139,12 +209,18 @@ void DFA_Automata::addTransitionState(State *input_state, State *to_state, char
 
 void DFA_Automata::start() noexcept { actualState_ = start_; }
 
-void DFA_Automata::synthesisFromNFA(const NFA_Automata *nfa_auto) {
+bool DFA_Automata::synthesisFromNFA(const NFA_Automata *nfa_auto, SynthesisBudget const& budget, bool merge_kernels, unsigned int threads) {
+    if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    if(threads > 1) return synthesisParallel(nfa_auto, budget, merge_kernels, threads);
+
     StatesGroupCollector collector;
+    ByteClasses byte_classes(nfa_auto);
+    unsigned long memory = 0;
 
     std::stack<State *> determenisticStates;
     auto endState = nfa_auto->getEndConnector();
     auto startStates = order_for_epsilon(nfa_auto->getBeginConnector());
+    if(merge_kernels) startStates = kernel(startStates, endState);
 
     State * startState = createState(startStates, endState);
     start_ = startState;
@@ -155,40 +231,211 @@ void DFA_Automata::synthesisFromNFA(const NFA_Automata *nfa_auto) {
     while (!determenisticStates.empty()) {
         State * working = determenisticStates.top();
         determenisticStates.pop();
-        auto symbolStates = single_order_for_symbol(working, collector);
+        auto symbolStates = single_order_for_symbol(working, collector, byte_classes);
 
         for (auto &i : symbolStates) {
             StatesGroup epsGroups = order_for_epsilon(i.second);
+            if(merge_kernels) epsGroups = kernel(epsGroups, endState);
             auto state_find = collector.findState(epsGroups);
+            auto const& members = byte_classes.members(byte_classes.classOf(i.first));
+            memory += members.size() * (sizeof(SymbolTransition) + sizeof(Transition*));
             if(state_find.second) {
-                addTransitionState(working, state_find.first, i.first);
+                for (auto &sym : members) addTransitionState(working, state_find.first, static_cast<char>(sym));
                 if(working == state_find.first) {
                     auto fin = collector.findStatesGroup(working);
-                    if(fin.second) {
-                        for (auto &b: fin.first.getStates()) {
-                            for (auto &c : b->getTransitions()) {
-                                auto sym_trans = dynamic_cast<SymbolTransition*>(c);
-                                if(sym_trans) {
-                                    if(sym_trans->getSymbol() == i.first) {
-                                        for (auto &d : sym_trans->getNextState()->getTransitions()) {
-                                            if(d->getNextState() == b) {
-                                                working->cycle();
-                                            }
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    }
+                    if(fin.second) markCycle(working, fin.first, i.first);
                 }
             } else {
+                // Every set node costs about the pointer and three links of a tree node
+                memory += sizeof(State) + epsGroups.getStates().size() * 4 * sizeof(void*);
+                if(budget.exceeded(collector.size() + 1, memory)) {
+                    collector.deleteStates();
+                    start_ = nullptr;
+                    actualState_ = nullptr;
+                    return false;
+                }
                 State * state_to = createState(epsGroups, endState);
                 state_to = addTransitionNewState(state_to, working, i.first);
+                for (unsigned int b = 1; b < members.size(); ++b) addTransitionState(working, state_to, static_cast<char>(members[b]));
                 collector.insert(epsGroups, state_to);
                 determenisticStates.push(state_to);
             }
         }
     }
+    return true;
+}
+
+// Workers take batches of unexplored states from the shared worklist. Every state is
+// explored by one worker, so only the worker adds its transitions; the sets are interned
+// in shards of the table locked separately
+bool DFA_Automata::synthesisParallel(const NFA_Automata *nfa_auto, SynthesisBudget const& budget, bool merge_kernels, unsigned int threads) {
+    struct Shard {
+        std::mutex mutex_;
+        std::map<StatesGroup, State *> states_;
+    };
+    typedef std::pair<State *, StatesGroup const*> Unexplored;
+
+    std::vector<Shard> shards(dfa_options::synthesis_shards);
+    ByteClasses byte_classes(nfa_auto);
+    auto endState = nfa_auto->getEndConnector();
+    std::atomic<unsigned long> states_count = 1;
+    std::atomic<unsigned long> memory = 0;
+    std::atomic<bool> failed = false;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_ready;
+    std::vector<Unexplored> queue;
+    // States in the worklist or being explored, the synthesis is over at zero
+    unsigned long pending = 1;
+
+    auto shardOf = [&](StatesGroup const& states_group) -> Shard & {
+        std::size_t hash = 0;
+        for (auto &i : states_group.getStates()) hash = hash * 31 + std::hash<State *>()(i);
+        return shards[hash % shards.size()];
+    };
+    // Returns the state of the set and the set in the table if the state is new
+    auto intern = [&](StatesGroup && states_group) -> Unexplored {
+        Shard & shard = shardOf(states_group);
+        std::lock_guard lock(shard.mutex_);
+        auto found = shard.states_.find(states_group);
+        if(found != shard.states_.end()) return {found->second, nullptr};
+        // Every set node costs about the pointer and three links of a tree node
+        unsigned long used = memory += sizeof(State) + states_group.getStates().size() * 4 * sizeof(void*);
+        if(budget.exceeded(++states_count, used)) { failed = true; return {nullptr, nullptr}; }
+        State * state = createState(states_group, endState);
+        auto inserted = shard.states_.emplace(std::move(states_group), state).first;
+        return {state, &inserted->first};
+    };
+
+    auto startStates = order_for_epsilon(nfa_auto->getBeginConnector());
+    if(merge_kernels) startStates = kernel(startStates, endState);
+    State * startState = createState(startStates, endState);
+    queue.emplace_back(startState, &shardOf(startStates).states_.emplace(startStates, startState).first->first);
+
+    auto explore = [&](Unexplored working, std::vector<Unexplored> & found) {
+        for (auto &i : moves(*working.second, byte_classes)) {
+            StatesGroup epsGroups = order_for_epsilon(i.second);
+            if(merge_kernels) epsGroups = kernel(epsGroups, endState);
+            Unexplored next = intern(std::move(epsGroups));
+            if(!next.first) return;
+            if(next.second) found.push_back(next);
+            auto const& members = byte_classes.members(byte_classes.classOf(i.first));
+            memory += members.size() * (sizeof(SymbolTransition) + sizeof(Transition*));
+            for (auto &sym : members) addTransitionState(working.first, next.first, static_cast<char>(sym));
+            if(working.first == next.first) markCycle(working.first, *working.second, i.first);
+        }
+    };
+
+    auto worker = [&]() {
+        std::vector<Unexplored> batch;
+        std::vector<Unexplored> found;
+        while (true) {
+            {
+                std::unique_lock lock(queue_mutex);
+                queue_ready.wait(lock, [&]() { return !queue.empty() || pending == 0 || failed; });
+                if(queue.empty() || failed) return;
+                unsigned long count = std::min<unsigned long>(queue.size(), dfa_options::synthesis_batch);
+                batch.assign(queue.end() - count, queue.end());
+                queue.resize(queue.size() - count);
+            }
+            found.clear();
+            for (auto &i : batch) {
+                if(failed) break;
+                explore(i, found);
+            }
+            std::lock_guard lock(queue_mutex);
+            queue.insert(queue.end(), found.begin(), found.end());
+            pending += found.size();
+            pending -= batch.size();
+            queue_ready.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < threads; ++i) workers.emplace_back(worker);
+    for (auto &i : workers) i.join();
+
+    if(failed) {
+        for (auto &shard : shards) {
+            for (auto &i : shard.states_) delete i.second;
+        }
+        start_ = nullptr;
+        actualState_ = nullptr;
+        return false;
+    }
+    start_ = startState;
+    return true;
+}
+
+// Suffixes are shared through the register of the states whose transitions are final:
+// a state is replaced with an equal registered one as soon as the next string leaves its branch
+void DFA_Automata::synthesisFromLiterals(std::vector<std::string> const& literals) {
+    struct Node {
+        bool isFinish_ = false;
+        std::vector<std::pair<unsigned char, unsigned long>> next_;
+        bool operator==(Node const&) const = default;
+    };
+    struct NodeHash {
+        std::size_t operator()(Node const& node) const noexcept {
+            std::size_t hash = node.isFinish_;
+            for (auto &i : node.next_) hash = (hash * 31 + i.first) * 1000003 + i.second;
+            return hash;
+        }
+    };
+
+    std::vector<std::string> sorted_literals;
+    std::vector<std::string> const* words = &literals;
+    if(!std::is_sorted(literals.begin(), literals.end())) {
+        sorted_literals = literals;
+        std::sort(sorted_literals.begin(), sorted_literals.end());
+        words = &sorted_literals;
+    }
+
+    std::vector<Node> nodes(1);
+    std::unordered_map<Node, unsigned long, NodeHash> registered;
+    // Nodes of the path of the previous string, path[i] is reached by its first i symbols
+    std::vector<unsigned long> path = {0};
+    auto replaceOrRegister = [&](unsigned long prefix) {
+        for (unsigned long i = path.size() - 1; i > prefix; --i) {
+            auto found = registered.try_emplace(nodes[path[i]], path[i]);
+            nodes[path[i - 1]].next_.back().second = found.first->second;
+        }
+        path.resize(prefix + 1);
+    };
+
+    std::string_view previous;
+    for (auto &word : *words) {
+        unsigned long prefix = 0;
+        while (prefix < word.size() && prefix < previous.size() && word[prefix] == previous[prefix]) ++prefix;
+        if(prefix == word.size() && prefix == previous.size() && &word != &words->front()) continue;
+        replaceOrRegister(prefix);
+        for (unsigned long i = prefix; i < word.size(); ++i) {
+            nodes[path.back()].next_.emplace_back(static_cast<unsigned char>(word[i]), nodes.size());
+            path.push_back(nodes.size());
+            nodes.emplace_back();
+        }
+        nodes[path.back()].isFinish_ = true;
+        previous = word;
+    }
+    replaceOrRegister(0);
+
+    std::unordered_map<unsigned long, State *> states;
+    std::vector<unsigned long> stack = {0};
+    states[0] = new State(nodes[0].isFinish_);
+    while (!stack.empty()) {
+        unsigned long working = stack.back();
+        stack.pop_back();
+        for (auto &i : nodes[working].next_) {
+            auto found = states.try_emplace(i.second, nullptr);
+            if(found.second) {
+                found.first->second = new State(nodes[i.second].isFinish_);
+                stack.push_back(i.second);
+            }
+            addTransitionState(states[working], found.first->second, static_cast<char>(i.first));
+        }
+    }
+    start_ = states[0];
+    actualState_ = nullptr;
 }
 
 void DFA_Automata::printDOT(const std::string &file_name) {
@@ -447,6 +694,126 @@ void DFA_Automata::optimize() {
     DevideStatesCollector devideStatesCollector(ordinaryStates, finishedStates);
     start_ =  devideStatesCollector.devideAutomata(start_);
 }
+
+// Runs 'work(thread, begin, end)' over [0, count) split into one range per thread
+static void parallelRanges(unsigned int threads, unsigned long count, std::function<void(unsigned int, unsigned long, unsigned long)> const& work) {
+    std::vector<std::thread> workers;
+    unsigned long step = (count + threads - 1) / threads;
+    for (unsigned int t = 1; t < threads; ++t) {
+        workers.emplace_back(work, t, std::min(count, t * step), std::min(count, (t + 1) * step));
+    }
+    work(0, 0, std::min(count, step));
+    for (auto &i : workers) i.join();
+}
+
+// States equal in a round have the same block and move to the same blocks by the same symbols,
+// missing transitions included. Every worker groups the states whose signature hash falls in
+// its shard, so the new blocks are exact and the numbering does not depend on the timing
+std::vector<MinimizationRound> DFA_Automata::optimizeParallel(unsigned int threads) {
+    std::vector<MinimizationRound> rounds;
+    if(!start_) return rounds;
+    if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<State *> states;
+    std::unordered_map<State *, unsigned long> index;
+    states.push_back(start_);
+    index[start_] = 0;
+    for (unsigned long i = 0; i < states.size(); ++i) {
+        for (auto &t : states[i]->getTransitions()) {
+            if(index.emplace(t->getNextState(), states.size()).second) states.push_back(t->getNextState());
+        }
+    }
+
+    // Transitions of state i are [offsets[i], offsets[i + 1]) sorted by symbol
+    std::vector<unsigned long> offsets(states.size() + 1, 0);
+    std::vector<std::pair<char, unsigned long>> moves;
+    for (unsigned long i = 0; i < states.size(); ++i) {
+        for (auto &t : states[i]->getTransitions()) {
+            auto work = dynamic_cast<SymbolTransition*>(t);
+            moves.emplace_back(work->getSymbol(), index[t->getNextState()]);
+        }
+        std::sort(moves.begin() + offsets[i], moves.end());
+        offsets[i + 1] = moves.size();
+    }
+
+    std::vector<unsigned long> block(states.size());
+    unsigned long blocks = 0;
+    bool finished = false, ordinary = false;
+    for (auto &i : states) (i->isFinishState() ? finished : ordinary) = true;
+    for (unsigned long i = 0; i < states.size(); ++i) block[i] = finished && ordinary && !states[i]->isFinishState();
+    blocks = finished + ordinary;
+
+    std::vector<std::size_t> hashes(states.size());
+    std::vector<unsigned long> next_block(states.size());
+    std::vector<unsigned long> shard_blocks(threads);
+    // States of every shard found by every hashing worker, in increasing order
+    std::vector<std::vector<std::vector<unsigned long>>> buckets(threads, std::vector<std::vector<unsigned long>>(threads));
+    auto equalSignatures = [&](unsigned long left, unsigned long right) {
+        if(block[left] != block[right] || offsets[left + 1] - offsets[left] != offsets[right + 1] - offsets[right]) return false;
+        for (unsigned long l = offsets[left], r = offsets[right]; l < offsets[left + 1]; ++l, ++r) {
+            if(moves[l].first != moves[r].first || block[moves[l].second] != block[moves[r].second]) return false;
+        }
+        return true;
+    };
+
+    while (true) {
+        auto round_start = std::chrono::steady_clock::now();
+        parallelRanges(threads, states.size(), [&](unsigned int worker, unsigned long begin, unsigned long end) {
+            for (auto &bucket : buckets[worker]) bucket.clear();
+            for (unsigned long i = begin; i < end; ++i) {
+                std::size_t hash = block[i];
+                for (unsigned long m = offsets[i]; m < offsets[i + 1]; ++m) {
+                    hash = (hash * 31 + static_cast<unsigned char>(moves[m].first)) * 1000003 + block[moves[m].second];
+                }
+                hashes[i] = hash;
+                buckets[worker][hash % threads].push_back(i);
+            }
+        });
+        // Every shard numbers its blocks from 0, then the numbers are moved past the blocks of the shards before
+        parallelRanges(threads, threads, [&](unsigned int shard, unsigned long, unsigned long) {
+            std::unordered_multimap<std::size_t, unsigned long> representatives;
+            unsigned long count = 0;
+            for (auto &bucket : buckets) {
+                for (auto &i : bucket[shard]) {
+                    auto range = representatives.equal_range(hashes[i]);
+                    auto found = std::find_if(range.first, range.second, [&](auto const& r) { return equalSignatures(r.second, i); });
+                    if(found != range.second) { next_block[i] = next_block[found->second]; continue; }
+                    representatives.emplace(hashes[i], i);
+                    next_block[i] = count++;
+                }
+            }
+            shard_blocks[shard] = count;
+        });
+        std::vector<unsigned long> shard_offsets(threads, 0);
+        for (unsigned int t = 1; t < threads; ++t) shard_offsets[t] = shard_offsets[t - 1] + shard_blocks[t - 1];
+        unsigned long new_blocks = shard_offsets.back() + shard_blocks.back();
+        parallelRanges(threads, states.size(), [&](unsigned int, unsigned long begin, unsigned long end) {
+            for (unsigned long i = begin; i < end; ++i) next_block[i] += shard_offsets[hashes[i] % threads];
+        });
+        block.swap(next_block);
+        rounds.push_back({new_blocks, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - round_start)});
+        // Blocks are only split, the same count is the same partition
+        if(new_blocks == blocks) break;
+        blocks = new_blocks;
+    }
+
+    std::vector<State *> groups(blocks, nullptr);
+    for (unsigned long i = 0; i < states.size(); ++i) {
+        if(!groups[block[i]]) groups[block[i]] = new State(states[i]->isFinishState());
+    }
+    std::vector<bool> linked(blocks, false);
+    for (unsigned long i = 0; i < states.size(); ++i) {
+        if(linked[block[i]]) continue;
+        linked[block[i]] = true;
+        for (unsigned long m = offsets[i]; m < offsets[i + 1]; ++m) {
+            groups[block[i]]->addTransition(new SymbolTransition(groups[block[moves[m].second]], moves[m].first));
+        }
+    }
+    start_ = groups[block[0]];
+    actualState_ = nullptr;
+    return rounds;
+}
+
 /*
 bool DFA_Automata::checkStr(const std::string & string) {
     State * actualState = start_;
@@ -5,7 +5,9 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <compare>
+#include <chrono>
 
 namespace state_type {
     typedef char state_type_;
@@ -13,6 +15,28 @@ namespace state_type {
     inline constexpr state_type_ ordinary  = 2;
 }
 
+namespace dfa_options {
+    inline constexpr unsigned long unlimited = static_cast<unsigned long>(-1);
+    // Locks of the set table of the parallel synthesis
+    inline constexpr unsigned long synthesis_shards = 64;
+    // States a worker of the parallel synthesis takes from the worklist at once
+    inline constexpr unsigned long synthesis_batch = 16;
+}
+
+// Limits of a subset construction, the deadline is counted from the creation of the budget.
+// Memory is an estimate of the states, transitions and state sets created by the synthesis
+class SynthesisBudget {
+    unsigned long max_states_ = dfa_options::unlimited;
+    unsigned long max_memory_ = dfa_options::unlimited;
+    std::chrono::steady_clock::time_point deadline_ = std::chrono::steady_clock::time_point::max();
+public:
+    SynthesisBudget() = default;
+    SynthesisBudget(unsigned long max_states, unsigned long max_memory, std::chrono::milliseconds max_time);
+    [[nodiscard]] bool exceeded(unsigned long states, unsigned long memory) const;
+    [[nodiscard]] unsigned long getMaxStates() const noexcept;
+    [[nodiscard]] unsigned long getMaxMemory() const noexcept;
+};
+
 class StatesGroup {
     std::set<State *> states_;
 public:
@@ -29,11 +53,21 @@ public:
 
 class StatesGroupCollector {
     std::map<StatesGroup, State *> collector_;
+    // Set of every state, the nodes of 'collector_' keep their addresses
+    std::unordered_map<State *, StatesGroup const*> groups_;
 public:
     StatesGroupCollector() = default;
     std::pair<State *, bool> findState(StatesGroup const& states_group);
     std::pair<StatesGroup const&, bool> findStatesGroup(State * state);
     std::pair<State *, bool> insert(StatesGroup const& states_group, State * state);
+    [[nodiscard]] unsigned long size() const noexcept;
+    void deleteStates();
+};
+
+// Blocks of the partition after a round of optimizeParallel and the time of the round
+struct MinimizationRound {
+    unsigned long blocks_;
+    std::chrono::microseconds time_;
 };
 
 struct StateCaptureGroupInfo {
@@ -49,17 +83,32 @@ protected:
 
     [[nodiscard]] static StatesGroup order_for_epsilon(State * state);
     [[nodiscard]] static StatesGroup order_for_epsilon(std::vector<State*> const& state);
-    [[nodiscard]] std::map<char, std::vector<State*>> single_order_for_symbol(State * state, StatesGroupCollector & collector);
+    [[nodiscard]] static StatesGroup kernel(StatesGroup const& states_group, State * endState);
+    [[nodiscard]] static std::map<char, std::vector<State*>> moves(StatesGroup const& states_group, ByteClasses const& byte_classes);
+    [[nodiscard]] std::map<char, std::vector<State*>> single_order_for_symbol(State * state, StatesGroupCollector & collector, ByteClasses const& byte_classes);
     [[nodiscard]] static State * addTransitionNewState(State *to_state, State * out_state, char transitionSymbol);
     [[nodiscard]] static State* createState(StatesGroup const& states_group, State * endState);
     static void addTransitionState(State * input_state, State * to_state, char transitionSymbol);
+    static void markCycle(State * working, StatesGroup const& states_group, char sym);
+    bool synthesisParallel(const NFA_Automata * nfa_auto, SynthesisBudget const& budget, bool merge_kernels, unsigned int threads);
 public:
     DFA_Automata() = default;
     explicit DFA_Automata(State * start);
-    void synthesisFromNFA(const NFA_Automata * nfa_auto);
+    // Returns false and keeps the automata empty if the budget is exceeded.
+    // With 'merge_kernels' sets of NFA states are kept without the states passed by epsilon
+    // transitions only, the usual important states key: sets with the same kernel are one
+    // DFA state. Epsilon-free NFAs like the position automata are not changed by it.
+    // With more than one thread the sets are explored in parallel, 0 is all hardware threads
+    bool synthesisFromNFA(const NFA_Automata * nfa_auto, SynthesisBudget const& budget = SynthesisBudget(), bool merge_kernels = false, unsigned int threads = 1);
+    // Minimal acyclic DFA of the set of strings built incrementally over the sorted strings
+    // (Daciuk et al.), the time is linear in the total length when the strings are sorted
+    void synthesisFromLiterals(std::vector<std::string> const& literals);
     void printDOT(std::string const& file_name);
     //bool checkStr(std::string const&); // TEST
     void optimize();
+    // Moore refinement in rounds over the flat array of the states: signatures of the states
+    // are computed by 'threads' workers, 0 is all hardware threads. Returns the rounds
+    std::vector<MinimizationRound> optimizeParallel(unsigned int threads = 0);
 
     [[nodiscard]] std::pair<bool, std::vector<StateCaptureGroupInfo>> getCaptureGroupInfo();
     [[nodiscard]] bool next_state(char sym);
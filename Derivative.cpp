@@ -0,0 +1,232 @@
+#include "Derivative.h"
+#include <algorithm>
+#include <queue>
+
+bool DerivativeTerm::operator==(DerivativeTerm const& term) const noexcept {
+    return kind_ == term.kind_ && symbols_ == term.symbols_ && children_ == term.children_;
+}
+
+std::size_t DerivativeTermHash::operator()(DerivativeTerm const& term) const noexcept {
+    std::size_t hash = std::hash<std::bitset<256>>()(term.symbols_) ^ term.kind_;
+    for (auto &i : term.children_) hash = hash * 31 + i;
+    return hash;
+}
+
+// DerivativeBuilder
+
+DerivativeBuilder::DerivativeBuilder() {
+    intern({derivative_kind::nothing, {}, {}, false});
+    intern({derivative_kind::epsilon, {}, {}, true});
+    intern({derivative_kind::complement, {}, {nothing()}, true});
+}
+
+unsigned int DerivativeBuilder::nothing() const noexcept { return 0; }
+
+unsigned int DerivativeBuilder::epsilon() const noexcept { return 1; }
+
+DerivativeTerm const &DerivativeBuilder::getTerm(unsigned int term) const noexcept { return terms_[term]; }
+
+unsigned long DerivativeBuilder::size() const noexcept { return terms_.size(); }
+
+unsigned int DerivativeBuilder::intern(DerivativeTerm &&term) {
+    auto found = table_.find(term);
+    if(found != table_.end()) return found->second;
+
+    switch (term.kind_) {
+        case derivative_kind::epsilon:
+        case derivative_kind::star:
+            term.nullable_ = true;
+            break;
+        case derivative_kind::concat:
+        case derivative_kind::intersection:
+            term.nullable_ = std::all_of(term.children_.begin(), term.children_.end(), [this](unsigned int i) { return terms_[i].nullable_; });
+            break;
+        case derivative_kind::alternative:
+            term.nullable_ = std::any_of(term.children_.begin(), term.children_.end(), [this](unsigned int i) { return terms_[i].nullable_; });
+            break;
+        case derivative_kind::complement:
+            term.nullable_ = !terms_[term.children_.front()].nullable_;
+            break;
+        default:
+            term.nullable_ = false;
+            break;
+    }
+    unsigned int id = terms_.size();
+    table_[term] = id;
+    terms_.push_back(std::move(term));
+    return id;
+}
+
+unsigned int DerivativeBuilder::symbols(std::bitset<256> const& symbols) {
+    if(symbols.none()) return nothing();
+    return intern({derivative_kind::symbols, symbols, {}, false});
+}
+
+unsigned int DerivativeBuilder::concat(unsigned int left, unsigned int right) {
+    if(left == nothing() || right == nothing()) return nothing();
+    if(left == epsilon()) return right;
+    if(right == epsilon()) return left;
+    // Concatenation is kept right-associative
+    if(terms_[left].kind_ == derivative_kind::concat) {
+        unsigned int first = terms_[left].children_[0];
+        unsigned int second = terms_[left].children_[1];
+        return concat(first, concat(second, right));
+    }
+    return intern({derivative_kind::concat, {}, {left, right}, false});
+}
+
+// Flattened, sorted and unique children: x|x = x, (x|y)|z = x|(y|z), x|y = y|x, the same for &.
+// The empty language and everything are the units and the zeroes
+unsigned int DerivativeBuilder::join(derivative_kind::kind kind, std::vector<unsigned int> const& children) {
+    unsigned int everything = complement(nothing());
+    unsigned int unit = kind == derivative_kind::alternative ? nothing() : everything;
+    unsigned int zero = kind == derivative_kind::alternative ? everything : nothing();
+
+    std::vector<unsigned int> flat;
+    std::bitset<256> merged;
+    for (auto &i : children) {
+        if(i == zero) return zero;
+        if(i == unit) continue;
+        if(terms_[i].kind_ == kind) {
+            flat.insert(flat.end(), terms_[i].children_.begin(), terms_[i].children_.end());
+        } else if(kind == derivative_kind::alternative && terms_[i].kind_ == derivative_kind::symbols) {
+            merged |= terms_[i].symbols_;
+        } else {
+            flat.push_back(i);
+        }
+    }
+    // Alternatives of symbols are one set of symbols
+    if(merged.any()) {
+        for (auto i = flat.begin(); i != flat.end();) {
+            if(terms_[*i].kind_ == derivative_kind::symbols) { merged |= terms_[*i].symbols_; i = flat.erase(i); }
+            else ++i;
+        }
+        flat.push_back(symbols(merged));
+    }
+    std::sort(flat.begin(), flat.end());
+    flat.erase(std::unique(flat.begin(), flat.end()), flat.end());
+    if(flat.empty()) return unit;
+    if(flat.size() == 1) return flat.front();
+    return intern({kind, {}, std::move(flat), false});
+}
+
+unsigned int DerivativeBuilder::alternative(unsigned int left, unsigned int right) {
+    return join(derivative_kind::alternative, {left, right});
+}
+
+unsigned int DerivativeBuilder::intersection(unsigned int left, unsigned int right) {
+    return join(derivative_kind::intersection, {left, right});
+}
+
+unsigned int DerivativeBuilder::complement(unsigned int term) {
+    if(terms_[term].kind_ == derivative_kind::complement) return terms_[term].children_.front();
+    return intern({derivative_kind::complement, {}, {term}, false});
+}
+
+unsigned int DerivativeBuilder::star(unsigned int term) {
+    if(term == nothing() || term == epsilon()) return epsilon();
+    if(terms_[term].kind_ == derivative_kind::star) return term;
+    return intern({derivative_kind::star, {}, {term}, true});
+}
+
+unsigned int DerivativeBuilder::reverse(unsigned int term) {
+    DerivativeTerm const working = terms_[term];
+    switch (working.kind_) {
+        case derivative_kind::concat:
+            return concat(reverse(working.children_[1]), reverse(working.children_[0]));
+        case derivative_kind::alternative:
+        case derivative_kind::intersection: {
+            std::vector<unsigned int> children;
+            for (auto &i : working.children_) children.push_back(reverse(i));
+            return join(working.kind_, children);
+        }
+        case derivative_kind::complement:
+            return complement(reverse(working.children_.front()));
+        case derivative_kind::star:
+            return star(reverse(working.children_.front()));
+        default:
+            return term;
+    }
+}
+
+unsigned int DerivativeBuilder::derive(unsigned int term, char sym) {
+    auto key = std::make_pair(term, static_cast<unsigned char>(sym));
+    auto found = derivatives_.find(key);
+    if(found != derivatives_.end()) return found->second;
+
+    DerivativeTerm const working = terms_[term];
+    unsigned int result = nothing();
+    switch (working.kind_) {
+        case derivative_kind::symbols:
+            result = working.symbols_.test(key.second) ? epsilon() : nothing();
+            break;
+        case derivative_kind::concat: {
+            unsigned int left = working.children_[0];
+            unsigned int right = working.children_[1];
+            result = concat(derive(left, sym), right);
+            if(terms_[left].nullable_) result = alternative(result, derive(right, sym));
+            break;
+        }
+        case derivative_kind::alternative:
+        case derivative_kind::intersection: {
+            std::vector<unsigned int> children;
+            for (auto &i : working.children_) children.push_back(derive(i, sym));
+            result = join(working.kind_, children);
+            break;
+        }
+        case derivative_kind::complement:
+            result = complement(derive(working.children_.front(), sym));
+            break;
+        case derivative_kind::star:
+            result = concat(derive(working.children_.front(), sym), term);
+            break;
+        default:
+            break;
+    }
+    derivatives_[key] = result;
+    return result;
+}
+
+bool DerivativeBuilder::synthesis(unsigned int term, DFA_Automata &automata, SynthesisBudget const& budget) {
+    // Derivatives are made of the sets of the term, so the bytes of a class have one derivative
+    std::vector<std::bitset<256>> labels;
+    for (auto &i : terms_) {
+        if(i.kind_ == derivative_kind::symbols) labels.push_back(i.symbols_);
+    }
+    ByteClasses byte_classes(labels);
+
+    std::map<unsigned int, State*> states;
+    std::queue<unsigned int> determenisticStates;
+    unsigned long memory = 0;
+    auto state = [&](unsigned int id) -> State * {
+        auto found = states.find(id);
+        if(found != states.end()) return found->second;
+        memory += sizeof(State) + 4 * sizeof(void*);
+        if(budget.exceeded(states.size() + 1, memory)) return nullptr;
+        auto created = new State(terms_[id].nullable_);
+        states[id] = created;
+        determenisticStates.push(id);
+        return created;
+    };
+    auto deleteStates = [&]() {
+        for (auto &i : states) delete i.second;
+    };
+
+    State * start = state(term);
+    if(!start) return false;
+    while (!determenisticStates.empty()) {
+        unsigned int working = determenisticStates.front();
+        determenisticStates.pop();
+        for (unsigned int k = 0; k < byte_classes.size(); ++k) {
+            auto const& members = byte_classes.members(k);
+            unsigned int next = derive(working, static_cast<char>(members.front()));
+            if(next == nothing()) continue;
+            State * next_state = state(next);
+            if(!next_state) { deleteStates(); return false; }
+            memory += members.size() * (sizeof(SymbolTransition) + sizeof(Transition*));
+            for (auto &sym : members) states[working]->addTransition(new SymbolTransition(next_state, static_cast<char>(sym)));
+        }
+    }
+    automata = DFA_Automata(start);
+    return true;
+}
@@ -0,0 +1,65 @@
+#ifndef LAB2_DERIVATIVE_H
+#define LAB2_DERIVATIVE_H
+
+#include "DFA.h"
+#include <vector>
+#include <bitset>
+#include <map>
+#include <unordered_map>
+
+namespace derivative_kind {
+    typedef unsigned char kind;
+    inline constexpr kind nothing = 0;
+    inline constexpr kind epsilon = 1;
+    inline constexpr kind symbols = 2;
+    inline constexpr kind concat = 3;
+    inline constexpr kind alternative = 4;
+    inline constexpr kind intersection = 5;
+    inline constexpr kind complement = 6;
+    inline constexpr kind star = 7;
+}
+
+// Alternative and intersection keep their children sorted and unique, concat has two children
+struct DerivativeTerm {
+    derivative_kind::kind kind_ = derivative_kind::nothing;
+    std::bitset<256> symbols_;
+    std::vector<unsigned int> children_;
+    bool nullable_ = false;
+    bool operator==(DerivativeTerm const& term) const noexcept;
+};
+
+struct DerivativeTermHash {
+    std::size_t operator()(DerivativeTerm const& term) const noexcept;
+};
+
+// Hash-consed regular expressions with the similarity rules of Brzozowski: equal terms have
+// one id, so the derivatives of a term are finitely many and every id becomes one DFA state
+class DerivativeBuilder {
+    std::vector<DerivativeTerm> terms_;
+    std::unordered_map<DerivativeTerm, unsigned int, DerivativeTermHash> table_;
+    std::map<std::pair<unsigned int, unsigned char>, unsigned int> derivatives_;
+
+    unsigned int intern(DerivativeTerm && term);
+    unsigned int join(derivative_kind::kind kind, std::vector<unsigned int> const& children);
+public:
+    DerivativeBuilder();
+    [[nodiscard]] unsigned int nothing() const noexcept;
+    [[nodiscard]] unsigned int epsilon() const noexcept;
+    [[nodiscard]] unsigned int symbols(std::bitset<256> const& symbols);
+    [[nodiscard]] unsigned int concat(unsigned int left, unsigned int right);
+    [[nodiscard]] unsigned int alternative(unsigned int left, unsigned int right);
+    [[nodiscard]] unsigned int intersection(unsigned int left, unsigned int right);
+    [[nodiscard]] unsigned int complement(unsigned int term);
+    [[nodiscard]] unsigned int star(unsigned int term);
+    // Term of the reversed words
+    [[nodiscard]] unsigned int reverse(unsigned int term);
+    [[nodiscard]] unsigned int derive(unsigned int term, char sym);
+    [[nodiscard]] DerivativeTerm const& getTerm(unsigned int term) const noexcept;
+    [[nodiscard]] unsigned long size() const noexcept;
+    // DFA with a state per derivative of 'term', transitions to the empty language are left out.
+    // Returns false and keeps the automata as is if the budget is exceeded
+    bool synthesis(unsigned int term, DFA_Automata & automata, SynthesisBudget const& budget = SynthesisBudget());
+    ~DerivativeBuilder() = default;
+};
+
+#endif //LAB2_DERIVATIVE_H
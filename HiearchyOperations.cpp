@@ -176,6 +176,30 @@ bool CaptureGroupOP::compaire(str_container::container &list,
     throw std::logic_error("Uncorrect capture group construction");
 }
 
+bool BackReferenceOP::compaire(str_container::container &list,
+                               str_container::iterator begin,
+                               str_container::iterator end) {
+    if(compaireNode<CaptureGroup>(*begin)) ++begin;
+
+    for (auto i = begin; i != end; ++i) {
+        if((*i)->getSymbol() != '<' || compaireNode<DefineNode>(*i)) continue;
+        std::string buffer;
+        auto name_iter = i;
+        ++name_iter;
+        for (; name_iter != end; ++name_iter) {
+            char sym = (*name_iter)->getSymbol();
+            if(isAlpha(sym) || (!buffer.empty() && isAlnum(sym))) buffer.push_back(sym);
+            else break;
+        }
+        if(buffer.empty() || name_iter == end || (*name_iter)->getSymbol() != '>') {
+            throw std::logic_error("Uncorrect back reference construction");
+        }
+        auto newNode = new BackReferenceNode(buffer);
+        i = str_container::replace(list, i, ++name_iter, newNode);
+    }
+    return CORRECT;
+}
+
 bool RepeatsOP::compaire(str_container::container &list, str_container::iterator begin, str_container::iterator end) {
     if(compaireNode<CaptureGroup>(*begin)) ++begin;
     auto symbolNodeIter = begin;
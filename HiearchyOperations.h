@@ -64,6 +64,13 @@ public:
     ~CaptureGroupOP() override = default;
 };
 
+class BackReferenceOP : public Operation {
+public:
+    BackReferenceOP() = default;
+    bool compaire(str_container::container& list, str_container::iterator begin, str_container::iterator end) final;
+    ~BackReferenceOP() override = default;
+};
+
 class RepeatsOP : public Operation {
 public:
     RepeatsOP() = default;
@@ -147,6 +154,7 @@ public:
 class opListOrdinary : public IOperationList {
     static inline operStorage opList_Ordinary = {
             new CaptureGroupOP,
+            new BackReferenceOP,
             new RepeatsOP,
             new KleenyStarOP,
             new OptionalOP,
@@ -161,6 +169,7 @@ public:
 
 class opListOrdinaryWithoutGroups : public IOperationList {
     static inline operStorage opList_Ordinary_WG = {
+            new BackReferenceOP,
             new RepeatsOP,
             new KleenyStarOP,
             new OptionalOP,
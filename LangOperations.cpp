@@ -13,6 +13,14 @@ Expr::Expr(char sym) {
     bracketsString(expr_);
 }
 
+Expr::Expr(std::vector<char> const& symbols) {
+    for (auto &i : symbols) {
+        if(!expr_.empty()) expr_ += '|';
+        expr_ += i;
+    }
+    bracketsString(expr_);
+}
+
 void Expr::addAND(const Expr &expr) {
     expr_ += expr.getExpression();
     bracketsString(expr_);
@@ -42,6 +50,8 @@ ExprTransition::ExprTransition(ExprState *next_state, ExprState *prev_state, Exp
 
 ExprState *ExprTransition::getNextState() const noexcept { return next_state_; }
 
+ExprState *ExprTransition::getPrevState() const noexcept { return prev_state_; }
+
 Expr &ExprTransition::expr() noexcept { return expression_; }
 
 ExprState::ExprState(bool isFinishState) : isFinishState_(isFinishState) {}
@@ -49,16 +59,30 @@ ExprState::ExprState(bool isFinishState) : isFinishState_(isFinishState) {}
 bool ExprState::addTransition(ExprTransition *transition) {
     if(!transition) return false;
     transitions_.push_back(transition);
+    transition->getNextState()->addInputTransition(transition);
     return true;
 }
 
+void ExprState::addInputTransition(ExprTransition *transition) { input_transitions_.push_back(transition); }
+
+void ExprState::deleteInputTransition(ExprTransition *transition) {
+    for (auto i = input_transitions_.begin(); i != input_transitions_.end() ; ++i) {
+        if(*i == transition) { input_transitions_.erase(i); return; }
+    }
+}
+
 void ExprState::finishState() { isFinishState_ = true; }
 
 bool ExprState::isFinishState() const noexcept { return isFinishState_; }
 
 bool ExprState::deleteTransition(ExprTransition *transition) {
     for (auto i = transitions_.begin(); i != transitions_.end() ; ++i) {
-        if(*i == transition) { transitions_.erase(i); delete transition; return true;}
+        if(*i == transition) {
+            transitions_.erase(i);
+            transition->getNextState()->deleteInputTransition(transition);
+            delete transition;
+            return true;
+        }
     }
     return false;
 }
@@ -67,6 +91,8 @@ std::vector<ExprTransition *> &ExprState::getTransitions() noexcept { return tra
 
 const std::vector<ExprTransition *> &ExprState::getTransitions() const noexcept { return transitions_; }
 
+const std::vector<ExprTransition *> &ExprState::getInputTransitions() const noexcept { return input_transitions_; }
+
 AutomataConverter::AutomataConverter(const DFA_Automata *automata) {
     std::map<State*, ExprState*> conformity;
     std::stack<State *> stack;
@@ -81,6 +107,7 @@ AutomataConverter::AutomataConverter(const DFA_Automata *automata) {
                 stack.push(i->getNextState());
             }
             conformity[working] = new ExprState(working->isFinishState());
+            states_.insert(conformity[working]);
         }
     }
 
@@ -97,9 +124,7 @@ AutomataConverter::AutomataConverter(const DFA_Automata *automata) {
                 groups[i->getNextState()].push_back(symTransition->getSymbol());
             }
             for ( auto &i : groups) {
-                Expr expr = Expr(i.second.front());
-                i.second.erase(i.second.begin());
-                for (auto &sym : i.second) { expr.addOR(Expr(sym)); }
+                Expr expr = Expr(i.second);
                 auto transition = new ExprTransition(conformity[i.first], conformity[working], expr);
                 conformity[working]->addTransition(transition);
             }
@@ -111,24 +136,9 @@ AutomataConverter::AutomataConverter(const DFA_Automata *automata) {
 }
 
 std::vector<std::pair<ExprState *, ExprTransition*>> AutomataConverter::findInputStates(ExprState *victim) {
-    std::stack<ExprState *> stack;
-    std::set<ExprState*> visited;
     std::vector<std::pair<ExprState *, ExprTransition*>> result;
-    stack.push(automata_start_);
-
-    while (!stack.empty()) {
-        ExprState * working = stack.top();
-        stack.pop();
-        if(!visited.count(working)) {
-            for (auto &i : working->getTransitions()) {
-                ExprState * next_state = i->getNextState();
-                stack.push(i->getNextState());
-                if(next_state == victim && working != victim) {
-                    result.push_back({ working, i });
-                }
-            }
-        }
-        visited.insert(working);
+    for (auto &i : victim->getInputTransitions()) {
+        if(i->getPrevState() != victim) { result.push_back({ i->getPrevState(), i }); }
     }
     return result;
 }
@@ -162,171 +172,72 @@ bool AutomataConverter::hasReverseStartTransition(ExprState *state) {
     return false;
 }
 
-std::set<ExprState *> AutomataConverter::findStates(bool isOrdinaryStates) {
-    std::stack<ExprState *> stack;
-    std::set<ExprState*> visited;
-    std::set<ExprState*> states;
-    stack.push(automata_start_);
-
-    while (!stack.empty()) {
-        ExprState * working = stack.top();
-        stack.pop();
-        if(!visited.count(working)) {
-            for (auto &i : working->getTransitions()) {
-                ExprState * next_state = i->getNextState();
-                stack.push(next_state);
-                if(next_state != automata_start_ && !states.count(next_state)) {
-                    if(isOrdinaryStates) {
-                        if(!next_state->isFinishState()) states.insert(next_state);
-                    }
-                    else {
-                        if(isOrdinaryFinish(next_state) && !hasReverseStartTransition(next_state)) states.insert(next_state);
-                    }
-                }
-            }
+std::vector<ExprState *> AutomataConverter::findStates(bool isOrdinaryStates) {
+    std::vector<ExprState*> states;
+    for (auto &i : states_) {
+        if(i == automata_start_) continue;
+        if(isOrdinaryStates) {
+            if(!i->isFinishState()) states.push_back(i);
+        }
+        else {
+            if(isOrdinaryFinish(i) && !hasReverseStartTransition(i)) states.push_back(i);
         }
-        visited.insert(working);
     }
     return states;
 }
 
-ExprState* AutomataConverter::findOrdinaryFinish() {
-    std::stack<ExprState *> stack;
-    std::set<ExprState*> visited;
-    stack.push(automata_start_);
-
-    while (!stack.empty()) {
-        ExprState * working = stack.top();
-        stack.pop();
-        if(!visited.count(working)) {
-            for (auto &i : working->getTransitions()) {
-                ExprState * next_state = i->getNextState();
-                stack.push(next_state);
-                if(next_state != automata_start_) {
-                    if(isOrdinaryFinish(next_state)) return next_state;
-                }
+void AutomataConverter::eliminateState(ExprState *victim, bool isFinishVictim) {
+    auto inputStates = findInputStates(victim);
+    auto outStates = findOutStates(victim);
+
+    ExprTransition *cycleTransition = findTransition(victim, victim);
+    for (auto &inp: inputStates) {
+        for (auto &out: outStates) {
+            ExprTransition *inp_to_out = findTransition(inp.first, out.first);
+            Expr expr = inp.second->getExpression();
+            if (cycleTransition) {
+                Expr kleeny = cycleTransition->getExpression();
+                kleeny.addKleeny();
+                expr.addAND(kleeny);
             }
-        }
-        visited.insert(working);
-    }
-    return nullptr;
-}
-
-void AutomataConverter::convert() {
-    std::set<ExprState*> states = findStates(true);
-
-    for (auto &i : states) {
-        auto inputStates = findInputStates(i);
-        auto outStates = findOutStates(i);
-
-        ExprTransition *cycleTransition = findTransition(i, i);
-        for (auto &inp: inputStates) {
-            for (auto &out: outStates) {
-                ExprTransition *inp_to_out = findTransition(inp.first, out.first);
-                if (inp_to_out) {
-                    if (cycleTransition) {
-                        Expr expr = inp.second->getExpression();
-                        Expr kleeny = cycleTransition->getExpression();
-                        kleeny.addKleeny();
-                        expr.addAND(kleeny);
-                        expr.addAND(out.second->getExpression());
-                        inp_to_out->expr().addOR(expr);
-                    } else {
-                        Expr expr = inp.second->getExpression();
-                        expr.addAND(out.second->getExpression());
-                        inp_to_out->expr().addOR(expr);
-                    }
-                } else {
-                    if (cycleTransition) {
-                        Expr expr = inp.second->getExpression();
-                        //if(inp.first->isFinishState()) expr.addOptional();
-                        Expr kleeny = cycleTransition->getExpression();
-                        kleeny.addKleeny();
-                        expr.addAND(kleeny);
-                        expr.addAND(out.second->getExpression());
-                        auto transition = new ExprTransition(out.first, inp.first, expr);
-                        inp.first->addTransition(transition);
-                    } else {
-                        Expr expr = inp.second->getExpression();
-                        //if(inp.first->isFinishState()) expr.addOptional();
-                        expr.addAND(out.second->getExpression());
-                        auto transition = new ExprTransition(out.first, inp.first, expr);
-                        inp.first->addTransition(transition);
-                    }
-                }
+            Expr out_expr = out.second->getExpression();
+            if (isFinishVictim) out_expr.addOptional();
+            expr.addAND(out_expr);
+            if (inp_to_out) {
+                inp_to_out->expr().addOR(expr);
+            } else {
+                auto transition = new ExprTransition(out.first, inp.first, expr);
+                inp.first->addTransition(transition);
             }
         }
-
-        for (auto &st: inputStates) {
-            st.first->deleteTransition(st.second);
-        }
-        for (auto &st: outStates) {
-            i->deleteTransition(st.second);
-        }
-        delete i;
     }
 
-    ExprState * find = findOrdinaryFinish();
-
-    while(find) {
-        auto inputStates = findInputStates(find);
-        auto outStates = findOutStates(find);
-        ExprTransition *cycleTransition = findTransition(find, find);
-        for (auto &inp: inputStates) {
-            for (auto &out: outStates) {
-                ExprTransition *inp_to_out = findTransition(inp.first, out.first);
-                if (inp_to_out) {
-                    if (cycleTransition) {
-                        Expr expr = inp.second->getExpression();
-                        Expr kleeny = cycleTransition->getExpression();
-                        kleeny.addKleeny();
-                        expr.addAND(kleeny);
-                        Expr optional = out.second->getExpression();
-                        optional.addOptional();
-                        expr.addAND(optional);
-                        inp_to_out->expr().addOR(expr);
-                        //if(inp.first->isFinishState()) inp_to_out->expr().addOptional();
-                    } else {
-                        Expr expr = inp.second->getExpression();
-                        Expr optional = out.second->getExpression();
-                        optional.addOptional();
-                        expr.addAND(optional);
-                        inp_to_out->expr().addOR(expr);
-                        //if(inp.first->isFinishState()) inp_to_out->expr().addOptional();
-                    }
-                } else {
-                    if (cycleTransition) {
-                        Expr expr = inp.second->getExpression();
-                        Expr kleeny = cycleTransition->getExpression();
-                        kleeny.addKleeny();
-                        expr.addAND(kleeny);
-                        Expr optional = out.second->getExpression();
-                        optional.addOptional();
-                        expr.addAND(optional);
-                        //if(inp.first->isFinishState()) expr.addOptional();
-                        auto transition = new ExprTransition(out.first, inp.first, expr);
-                        inp.first->addTransition(transition);
-                    } else {
-                        Expr expr = inp.second->getExpression();
-                        Expr optional = out.second->getExpression();
-                        optional.addOptional();
-                        expr.addAND(optional);
-                        //if(inp.first->isFinishState()) expr.addOptional();
-                        auto transition = new ExprTransition(out.first, inp.first, expr);
-                        inp.first->addTransition(transition);
-                    }
-                }
-            }
-        }
+    for (auto &st: inputStates) {
+        st.first->deleteTransition(st.second);
+    }
+    for (auto &st: outStates) {
+        victim->deleteTransition(st.second);
+    }
+    states_.erase(victim);
+    delete victim;
+}
 
-        for (auto &st: inputStates) {
-            st.first->deleteTransition(st.second);
-        }
-        for (auto &st: outStates) {
-            find->deleteTransition(st.second);
+void AutomataConverter::convert() {
+    for (auto &i : findStates(true)) { eliminateState(i, false); }
+
+    // Only predecessors of an eliminated state change their out-transitions,
+    // so they are the only states that have to be checked again
+    std::stack<ExprState*> finishStates;
+    for (auto &i : states_) { if(i != automata_start_) finishStates.push(i); }
+
+    while (!finishStates.empty()) {
+        ExprState * find = finishStates.top();
+        finishStates.pop();
+        if(!states_.count(find) || !isOrdinaryFinish(find)) continue;
+        for (auto &inp : findInputStates(find)) {
+            if(inp.first != automata_start_) finishStates.push(inp.first);
         }
-        delete find;
-        find = findOrdinaryFinish();
+        eliminateState(find, true);
     }
 
     for (auto &i : automata_start_->getTransitions()) {
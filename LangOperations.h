@@ -9,6 +9,8 @@ class Expr {
 public:
     Expr() = default;
     explicit Expr(char sym);
+    // Flat alternative of the symbols of a class: (a|b|c)
+    explicit Expr(std::vector<char> const& symbols);
     void addAND(Expr const& expr);
     void addOR(Expr const& expr);
     void addOptional();
@@ -26,6 +28,7 @@ public:
     explicit ExprTransition(ExprState * next_state, ExprState * prev_state, char sym);
     explicit ExprTransition(ExprState * next_state, ExprState * prev_state, Expr expr);
     [[nodiscard]] ExprState * getNextState() const noexcept;
+    [[nodiscard]] ExprState * getPrevState() const noexcept;
     Expr & expr() noexcept;
     [[nodiscard]] Expr getExpression() const noexcept;
     ~ExprTransition() = default;
@@ -33,7 +36,10 @@ public:
 
 class ExprState {
     std::vector<ExprTransition*> transitions_;
+    std::vector<ExprTransition*> input_transitions_;
     bool isFinishState_ = false;
+    void addInputTransition(ExprTransition * transition);
+    void deleteInputTransition(ExprTransition * transition);
 public:
     ExprState() = default;
     explicit ExprState(bool isFinishState);
@@ -43,20 +49,22 @@ public:
     [[nodiscard]] bool isFinishState() const noexcept;
     [[nodiscard]] std::vector<ExprTransition*> const& getTransitions() const noexcept;
     [[nodiscard]] std::vector<ExprTransition*> & getTransitions() noexcept;
+    [[nodiscard]] std::vector<ExprTransition*> const& getInputTransitions() const noexcept;
     bool deleteTransition(ExprTransition * transition);
     ~ExprState() = default;
 };
 
 class AutomataConverter {
     ExprState * automata_start_ = nullptr;
+    std::set<ExprState*> states_;
     Expr expr_;
-    std::set<ExprState*> findStates(bool isOrdinaryStates);
-    ExprState * findOrdinaryFinish();
+    std::vector<ExprState*> findStates(bool isOrdinaryStates);
     std::vector<std::pair<ExprState *, ExprTransition*>> findInputStates(ExprState * victim);
     std::vector<std::pair<ExprState *, ExprTransition*>> findOutStates(ExprState * victim);
     ExprTransition * findTransition(ExprState * start, ExprState * finish);
     bool isOrdinaryFinish(ExprState * state);
     bool hasReverseStartTransition(ExprState * state);
+    void eliminateState(ExprState * victim, bool isFinishVictim);
 public:
     explicit AutomataConverter(DFA_Automata const* automata);
     void convert();
@@ -0,0 +1,171 @@
+#include "LazyDFA.h"
+#include <algorithm>
+
+void LazyDFA_Automata::synthesisFromProgram(const PikeVM &pike_vm, unsigned long max_states) {
+    *this = LazyDFA_Automata();
+    program_ = pike_vm.getProgram();
+    classes_ = pike_vm.getClasses();
+    program_start_ = pike_vm.getStartInstruction();
+    max_states_ = std::max(max_states, lazy_dfa_options::min_cache_states);
+    visited_.assign(program_.size(), false);
+}
+
+bool LazyDFA_Automata::isEmpty() const noexcept { return program_.empty(); }
+
+unsigned long LazyDFA_Automata::getCachedStates() const noexcept { return sets_.size(); }
+
+unsigned long LazyDFA_Automata::getFlushes() const noexcept { return flushes_; }
+
+unsigned long LazyDFA_Automata::stateMemory() noexcept {
+    // A row of the table, the set of instructions and a node of the collector
+    return 256 * sizeof(unsigned int) + 2 * sizeof(std::vector<unsigned int>) + 8 * sizeof(void*);
+}
+
+std::vector<unsigned int> LazyDFA_Automata::closure(const std::vector<unsigned int> &pcs) {
+    std::vector<unsigned int> result;
+    std::vector<unsigned int> touched;
+    for (auto &i : pcs) stack_.push_back(i);
+
+    while (!stack_.empty()) {
+        unsigned int pc = stack_.back();
+        stack_.pop_back();
+        if(visited_[pc]) continue;
+        visited_[pc] = true;
+        touched.push_back(pc);
+
+        PikeInstruction const& instruction = program_[pc];
+        switch (instruction.opcode_) {
+            case pike_opcode::split:
+                stack_.push_back(instruction.y_);
+                stack_.push_back(instruction.x_);
+                break;
+            case pike_opcode::jump:
+            case pike_opcode::save:
+                stack_.push_back(instruction.x_);
+                break;
+            case pike_opcode::symbol:
+            case pike_opcode::symbol_class:
+            case pike_opcode::match:
+                result.push_back(pc);
+                break;
+            default:
+                break;
+        }
+    }
+
+    for (auto &i : touched) visited_[i] = false;
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+unsigned int LazyDFA_Automata::intern(std::vector<unsigned int> &&set, bool search) {
+    auto & collector = search ? search_collector_ : collector_;
+    auto found = collector.find(set);
+    if(found != collector.end()) return found->second;
+    if(sets_.size() >= max_states_) return lazy_dfa_options::unknown;
+
+    unsigned int id = sets_.size();
+    bool accept = false;
+    for (auto &i : set) {
+        if(program_[i].opcode_ == pike_opcode::match) { accept = true; break; }
+    }
+    collector[set] = id;
+    sets_.push_back(std::move(set));
+    accept_.push_back(accept);
+    search_.push_back(search);
+    transitions_.resize(transitions_.size() + 256, lazy_dfa_options::unknown);
+    return id;
+}
+
+void LazyDFA_Automata::flush() {
+    collector_.clear();
+    search_collector_.clear();
+    sets_.clear();
+    accept_.clear();
+    search_.clear();
+    transitions_.clear();
+    start_ = lazy_dfa_options::unknown;
+    search_start_ = lazy_dfa_options::unknown;
+    ++flushes_;
+}
+
+unsigned int LazyDFA_Automata::startState(bool search) {
+    unsigned int & start = search ? search_start_ : start_;
+    if(start != lazy_dfa_options::unknown) return start;
+    auto set = closure({program_start_});
+    start = intern(std::vector<unsigned int>(set), search);
+    if(start == lazy_dfa_options::unknown) {
+        flush();
+        start = intern(std::move(set), search);
+    }
+    return start;
+}
+
+unsigned int LazyDFA_Automata::next_state(unsigned int state, unsigned char sym) {
+    unsigned int cached = transitions_[state * 256 + sym];
+    if(cached != lazy_dfa_options::unknown) return cached;
+
+    std::vector<unsigned int> targets;
+    bool search = search_[state];
+    if(search) targets.push_back(program_start_);
+    for (auto &i : sets_[state]) {
+        if(consumesSymbol(program_[i], classes_, static_cast<char>(sym))) {
+            targets.push_back(program_[i].x_);
+        }
+    }
+    auto set = closure(targets);
+    unsigned int next = intern(std::vector<unsigned int>(set), search);
+    if(next != lazy_dfa_options::unknown) {
+        transitions_[state * 256 + sym] = next;
+        return next;
+    }
+
+    // 'state' does not survive the flush, the transition is recomputed next time
+    flush();
+    return intern(std::move(set), search);
+}
+
+bool LazyDFA_Automata::match(std::string_view str) {
+    if(isEmpty()) return false;
+    unsigned int state = startState();
+    for (auto &i : str) {
+        state = next_state(state, static_cast<unsigned char>(i));
+        if(sets_[state].empty()) return false;
+    }
+    return accept_[state];
+}
+
+tag_type::tag_value LazyDFA_Automata::longestMatch(std::string_view str, tag_type::tag_value from) {
+    if(isEmpty()) return tag_type::empty;
+    unsigned int state = startState();
+    tag_type::tag_value last_accept = accept_[state] ? from : tag_type::empty;
+    for (unsigned long i = from; i < str.size(); ++i) {
+        state = next_state(state, static_cast<unsigned char>(str[i]));
+        if(sets_[state].empty()) break;
+        if(accept_[state]) last_accept = i + 1;
+    }
+    return last_accept;
+}
+
+void LazyDFA_Automata::matchEnds(std::string_view str, tag_type::tag_value from, std::vector<tag_type::tag_value> &ends) {
+    ends.clear();
+    if(isEmpty()) return;
+    unsigned int state = startState();
+    if(accept_[state]) ends.push_back(from);
+    for (unsigned long i = from; i < str.size(); ++i) {
+        state = next_state(state, static_cast<unsigned char>(str[i]));
+        if(sets_[state].empty()) break;
+        if(accept_[state]) ends.push_back(i + 1);
+    }
+}
+
+bool LazyDFA_Automata::search(std::string_view str) {
+    if(isEmpty()) return false;
+    unsigned int state = startState(true);
+    if(accept_[state]) return true;
+    for (auto &i : str) {
+        state = next_state(state, static_cast<unsigned char>(i));
+        if(accept_[state]) return true;
+    }
+    return false;
+}
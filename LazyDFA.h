@@ -0,0 +1,58 @@
+#ifndef LAB2_LAZYDFA_H
+#define LAB2_LAZYDFA_H
+
+#include "PikeVM.h"
+#include <vector>
+#include <map>
+#include <string_view>
+
+namespace lazy_dfa_options {
+    // The states cache is not worth it below this count, the Pike VM is used instead
+    inline constexpr unsigned long min_cache_states = 16;
+    inline constexpr unsigned int unknown = static_cast<unsigned int>(-1);
+}
+
+// DFA states are determinized from the Pike VM program on demand: a state is the set of
+// symbol and match instructions reachable without input. States of the search add the start
+// instructions after every symbol and are cached apart. The cache holds at most
+// 'max_states_' states and is flushed entirely when it is full
+class LazyDFA_Automata {
+    std::vector<PikeInstruction> program_;
+    std::vector<std::bitset<256>> classes_;
+    unsigned int program_start_ = 0;
+    std::map<std::vector<unsigned int>, unsigned int> collector_;
+    std::map<std::vector<unsigned int>, unsigned int> search_collector_;
+    std::vector<std::vector<unsigned int>> sets_;
+    std::vector<unsigned int> transitions_;
+    std::vector<bool> accept_;
+    std::vector<bool> search_;
+    unsigned int start_ = lazy_dfa_options::unknown;
+    unsigned int search_start_ = lazy_dfa_options::unknown;
+    unsigned long max_states_ = 0;
+    unsigned long flushes_ = 0;
+    std::vector<unsigned int> stack_;
+    std::vector<bool> visited_;
+
+    [[nodiscard]] std::vector<unsigned int> closure(std::vector<unsigned int> const& pcs);
+    unsigned int intern(std::vector<unsigned int> && set, bool search);
+    void flush();
+    unsigned int startState(bool search = false);
+    unsigned int next_state(unsigned int state, unsigned char sym);
+public:
+    LazyDFA_Automata() = default;
+    void synthesisFromProgram(PikeVM const& pike_vm, unsigned long max_states);
+    [[nodiscard]] bool isEmpty() const noexcept;
+    [[nodiscard]] unsigned long getCachedStates() const noexcept;
+    [[nodiscard]] unsigned long getFlushes() const noexcept;
+    [[nodiscard]] static unsigned long stateMemory() noexcept;
+    [[nodiscard]] bool match(std::string_view str);
+    // End of the longest match starting at 'from' or tag_type::empty
+    [[nodiscard]] tag_type::tag_value longestMatch(std::string_view str, tag_type::tag_value from);
+    // Every end of a match starting at 'from' in increasing order
+    void matchEnds(std::string_view str, tag_type::tag_value from, std::vector<tag_type::tag_value> & ends);
+    // Some substring of the string is in the language, one pass over the search states
+    [[nodiscard]] bool search(std::string_view str);
+    ~LazyDFA_Automata() = default;
+};
+
+#endif //LAB2_LAZYDFA_H
@@ -0,0 +1,46 @@
+#include "MappedFile.h"
+#include <stdexcept>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(std::string const& path) {
+    int descriptor = open(path.c_str(), O_RDONLY);
+    if(descriptor == -1) throw std::logic_error("File can't be opened: " + path);
+    struct stat info{};
+    if(fstat(descriptor, &info) == -1) {
+        close(descriptor);
+        throw std::logic_error("File can't be opened: " + path);
+    }
+    size_ = info.st_size;
+    if(size_) {
+        void * data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if(data == MAP_FAILED) {
+            close(descriptor);
+            throw std::logic_error("File can't be mapped: " + path);
+        }
+        madvise(data, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char *>(data);
+    }
+    // The mapping stays valid without the descriptor
+    close(descriptor);
+}
+
+MappedFile::MappedFile(MappedFile &&file) noexcept
+    : data_(std::exchange(file.data_, nullptr)), size_(std::exchange(file.size_, 0)) {}
+
+MappedFile &MappedFile::operator=(MappedFile &&file) noexcept {
+    if(this == &file) return *this;
+    if(data_) munmap(const_cast<char *>(data_), size_);
+    data_ = std::exchange(file.data_, nullptr);
+    size_ = std::exchange(file.size_, 0);
+    return *this;
+}
+
+std::string_view MappedFile::view() const noexcept { return {data_, size_}; }
+
+MappedFile::~MappedFile() {
+    if(data_) munmap(const_cast<char *>(data_), size_);
+}
@@ -0,0 +1,22 @@
+#ifndef LAB2_MAPPEDFILE_H
+#define LAB2_MAPPEDFILE_H
+
+#include <string>
+#include <string_view>
+
+// Read-only mapping of a whole file advised for sequential access, empty files have no mapping
+class MappedFile {
+    const char * data_ = nullptr;
+    unsigned long size_ = 0;
+public:
+    MappedFile() = default;
+    explicit MappedFile(std::string const& path);
+    MappedFile(MappedFile const&) = delete;
+    MappedFile & operator=(MappedFile const&) = delete;
+    MappedFile(MappedFile && file) noexcept;
+    MappedFile & operator=(MappedFile && file) noexcept;
+    [[nodiscard]] std::string_view view() const noexcept;
+    ~MappedFile();
+};
+
+#endif //LAB2_MAPPEDFILE_H
@@ -4,6 +4,8 @@
 #include <stack>
 #include <set>
 #include <fstream>
+#include <algorithm>
+#include <unordered_set>
 
 
 // State
@@ -30,6 +32,12 @@ void State::cycle() { can_cycle_ = true; }
 
 std::vector<Transition*> &State::getTransitions() noexcept { return transitions_; }
 
+State *State::copy() const {
+    auto state = new State(isFinishState_);
+    state->can_cycle_ = can_cycle_;
+    return state;
+}
+
 State::~State() { for (auto &i : transitions_)  delete i; }
 
 CaptureGroupState::CaptureGroupState(Transition * transition, std::string group_name) : State({transition}) {
@@ -59,6 +67,42 @@ void CaptureGroupState::addInfo(std::string const& group_name, bool is_Start, bo
 
 std::string CaptureGroupState::getCaptureGroupName() { return group_name_; }
 
+State *CaptureGroupState::copy() const {
+    auto state = new CaptureGroupState(group_name_);
+    state->isFinishState_ = isFinishState_;
+    state->can_cycle_ = can_cycle_;
+    state->isStart_ = isStart_;
+    state->isFinish_ = isFinish_;
+    state->captureInfo = captureInfo;
+    return state;
+}
+
+BackReferenceState::BackReferenceState(std::string group_name) : State() {
+    group_name_ = std::move(group_name);
+}
+
+std::string BackReferenceState::getCaptureGroupName() { return group_name_; }
+
+State *BackReferenceState::copy() const {
+    auto state = new BackReferenceState(group_name_);
+    state->isFinishState_ = isFinishState_;
+    state->can_cycle_ = can_cycle_;
+    return state;
+}
+
+CountingState::CountingState(std::bitset<256> const& symbols, unsigned int count) : State(), symbols_(symbols), count_(count) {}
+
+std::bitset<256> const &CountingState::getSymbols() const noexcept { return symbols_; }
+
+unsigned int CountingState::getCount() const noexcept { return count_; }
+
+State *CountingState::copy() const {
+    auto state = new CountingState(symbols_, count_);
+    state->isFinishState_ = isFinishState_;
+    state->can_cycle_ = can_cycle_;
+    return state;
+}
+
 // Transition
 
 char Transition::getPriority() const { return priority_; }
@@ -76,6 +120,8 @@ Transition::Transition(State *next_state) {
 
 State *Transition::getNextState() noexcept { return next_state_; }
 
+Transition *Transition::copy(State *next_state) const { return new Transition(next_state, priority_); }
+
 Transition::~Transition() noexcept { }
 
 SymbolTransition::SymbolTransition(State *next_state_, char sym) : Transition(next_state_) {
@@ -84,14 +130,46 @@ SymbolTransition::SymbolTransition(State *next_state_, char sym) : Transition(ne
 
 char SymbolTransition::getSymbol() const noexcept { return sym_; }
 
+Transition *SymbolTransition::copy(State *next_state) const { return new SymbolTransition(next_state, sym_); }
+
 EpsilonTransition::EpsilonTransition(State *next_state_) : Transition(next_state_) {}
 
 EpsilonTransition::EpsilonTransition(State *next_state_, char priority) : Transition(next_state_, priority) {}
 
+SymbolClassTransition::SymbolClassTransition(State *next_state_, std::bitset<256> const& symbols) : Transition(next_state_), symbols_(symbols) {}
+
+std::bitset<256> const &SymbolClassTransition::getSymbols() const noexcept { return symbols_; }
+
+bool SymbolClassTransition::hasSymbol(char sym) const noexcept { return symbols_.test(static_cast<unsigned char>(sym)); }
+
+std::string SymbolClassTransition::getLabel() const {
+    std::string label = "[";
+    for (unsigned int i = 0; i < symbols_.size(); ++i) {
+        if(symbols_.test(i)) label += static_cast<char>(i);
+    }
+    return label + "]";
+}
+
+Transition *SymbolClassTransition::copy(State *next_state) const { return new SymbolClassTransition(next_state, symbols_); }
+
+Transition *EpsilonTransition::copy(State *next_state) const { return new EpsilonTransition(next_state, priority_); }
+
+BackReferenceTransition::BackReferenceTransition(State *next_state_) : Transition(next_state_) {}
+
+Transition *BackReferenceTransition::copy(State *next_state) const { return new BackReferenceTransition(next_state); }
+
+std::vector<Transition*> priorityTransitions(State * state) {
+    std::vector<Transition*> ordered = state->getTransitions();
+    std::stable_sort(ordered.begin(), ordered.end(), [](Transition * a, Transition * b) {
+        return a->getPriority() > b->getPriority();
+    });
+    return ordered;
+}
+
 // Automata
 
 NFA_Automata::NFA_Automata(State *begin, State *end) {
-    if(!begin || !end) { return; }
+    if(!begin) { return; }
     begin_connector_ = begin;
     end_connector_ = end;
 }
@@ -110,6 +188,106 @@ void NFA_Automata::dismissConnectors() {
     end_connector_ = nullptr;
 }
 
+NFA_Automata *NFA_Automata::clone() const { return IndexedNFA(this).copy(); }
+
+// ByteClasses
+
+ByteClasses::ByteClasses(const NFA_Automata *nfa_auto) {
+    std::unordered_set<std::bitset<256>> labels;
+    std::set<State *> visited;
+    std::stack<State *> stack;
+    stack.push(nfa_auto->getBeginConnector());
+    while (!stack.empty()) {
+        State * working = stack.top();
+        stack.pop();
+        if(visited.count(working)) continue;
+        visited.insert(working);
+        for (auto &i : working->getTransitions()) {
+            auto sym_transition = dynamic_cast<SymbolTransition*>(i);
+            auto class_transition = dynamic_cast<SymbolClassTransition*>(i);
+            if(sym_transition) labels.insert(std::bitset<256>().set(static_cast<unsigned char>(sym_transition->getSymbol())));
+            if(class_transition) labels.insert(class_transition->getSymbols());
+            if(!visited.count(i->getNextState())) stack.push(i->getNextState());
+        }
+    }
+    *this = ByteClasses(std::vector<std::bitset<256>>(labels.begin(), labels.end()));
+}
+
+ByteClasses::ByteClasses(std::vector<std::bitset<256>> const& labels) {
+    // Every label splits the classes it cuts, the numbers are made dense at the end
+    unsigned int count = 1;
+    for (auto &label : labels) {
+        std::vector<int> split(count, -1);
+        for (unsigned int i = 0; i < 256; ++i) {
+            if(!label.test(i)) continue;
+            if(split[classes_[i]] == -1) split[classes_[i]] = static_cast<int>(count++);
+            classes_[i] = split[classes_[i]];
+        }
+    }
+    std::vector<int> dense(count, -1);
+    for (unsigned int i = 0; i < 256; ++i) {
+        if(dense[classes_[i]] == -1) {
+            dense[classes_[i]] = static_cast<int>(members_.size());
+            members_.emplace_back();
+        }
+        classes_[i] = dense[classes_[i]];
+        members_[classes_[i]].push_back(i);
+    }
+}
+
+unsigned int ByteClasses::size() const noexcept { return members_.size(); }
+
+unsigned int ByteClasses::classOf(char sym) const noexcept { return classes_[static_cast<unsigned char>(sym)]; }
+
+std::vector<unsigned char> const &ByteClasses::members(unsigned int byte_class) const noexcept { return members_[byte_class]; }
+
+void ByteClasses::transitionClasses(Transition *transition, std::vector<unsigned int> &classes) const {
+    classes.clear();
+    auto sym_transition = dynamic_cast<SymbolTransition*>(transition);
+    if(sym_transition) { classes.push_back(classOf(sym_transition->getSymbol())); return; }
+    auto class_transition = dynamic_cast<SymbolClassTransition*>(transition);
+    if(!class_transition) return;
+    for (unsigned int i = 0; i < members_.size(); ++i) {
+        if(class_transition->getSymbols().test(members_[i].front())) classes.push_back(i);
+    }
+}
+
+// IndexedNFA
+
+IndexedNFA::IndexedNFA(const NFA_Automata *nfa_auto) {
+    std::map<State*, unsigned int> indexes;
+    auto index = [&](State * state) {
+        auto found = indexes.find(state);
+        if(found != indexes.end()) return found->second;
+        unsigned int id = states_.size();
+        indexes[state] = id;
+        states_.push_back(state);
+        return id;
+    };
+
+    begin_ = index(nfa_auto->getBeginConnector());
+    end_ = index(nfa_auto->getEndConnector());
+    for (unsigned int i = 0; i < states_.size(); ++i) {
+        std::vector<unsigned int> targets;
+        for (auto &b : states_[i]->getTransitions()) targets.push_back(index(b->getNextState()));
+        targets_.push_back(std::move(targets));
+    }
+}
+
+NFA_Automata *IndexedNFA::copy() const {
+    std::vector<State*> states;
+    states.reserve(states_.size());
+    for (auto &i : states_) states.push_back(i->copy());
+
+    for (unsigned int i = 0; i < states_.size(); ++i) {
+        auto const& transitions = states_[i]->getTransitions();
+        for (unsigned int b = 0; b < transitions.size(); ++b) {
+            states[i]->addTransition(transitions[b]->copy(states[targets_[i][b]]));
+        }
+    }
+    return new NFA_Automata(states[begin_], states[end_]);
+}
+
 // Automata
 
 NFA_Automata *Node::createAutomata() { throw std::logic_error("Node don't have automata"); }
@@ -123,6 +301,14 @@ NFA_Automata *SymbolNode::createAutomata() {
     return automata;
 }
 
+NFA_Automata *CharSetNode::createAutomata() {
+    auto beginState = new State();
+    auto endState = new State();
+    beginState->addTransition(new SymbolClassTransition(endState, symbols_));
+    auto automata = new NFA_Automata(beginState, endState);
+    return automata;
+}
+
 NFA_Automata *CaptureGroupNode::createAutomata() {
     auto prev_automata= getNode()->createAutomata();
 
@@ -142,6 +328,28 @@ NFA_Automata *CaptureGroupNode::createAutomata() {
     return automata;
 }
 
+NFA_Automata *BackReferenceNode::createAutomata() {
+    if(!group_) throw std::logic_error("Capture group of back reference is not founded");
+    if(inProcess_) throw std::logic_error("Back reference inside of its own capture group");
+
+    // The DFA follows the language of the group (the captured string is one of its words),
+    // the back reference matcher follows BackReferenceTransition only
+    inProcess_ = true;
+    auto group_automata = group_->getNode()->createAutomata();
+    inProcess_ = false;
+
+    auto beginState = new BackReferenceState(name_);
+    auto endState = new State();
+    beginState->addTransition(new BackReferenceTransition(endState));
+    beginState->addTransition(new EpsilonTransition(group_automata->getBeginConnector()));
+    group_automata->addTransition(new EpsilonTransition(endState));
+
+    auto automata = new NFA_Automata(beginState, endState);
+    group_automata->dismissConnectors();
+    delete group_automata;
+    return automata;
+}
+
 NFA_Automata *EmptyNode::createAutomata() {
     auto beginState = new State();
     auto endState = new State();
@@ -194,19 +402,29 @@ NFA_Automata *Optional::createAutomata() {
     return automata;
 }
 
+// The node is turned into an automata once, the other repeats are its copies
 NFA_Automata *MatchTimes::createAutomata() {
     unsigned long count = getCount();
     auto beginState = new State();
     State * prev_new_state = beginState;
 
-    while (count) {
-        auto prev_automata = getNode()->createAutomata();
-        auto new_prev_to_prev_transition = new EpsilonTransition(prev_automata->getBeginConnector());
-        prev_new_state->addTransition(new_prev_to_prev_transition);
-        prev_new_state = prev_automata->getEndConnector();
-        prev_automata->dismissConnectors();
-        delete prev_automata;
-        --count;
+    if(counting_) {
+        auto counter = new CountingState(symbols_, count);
+        beginState->addTransition(new EpsilonTransition(counter));
+        prev_new_state = counter;
+    } else if(count) {
+        // Copies are made before the linking changes the states of the prototype
+        std::vector<NFA_Automata*> automatas = {getNode()->createAutomata()};
+        IndexedNFA prototype(automatas.front());
+        while (automatas.size() < count) automatas.push_back(prototype.copy());
+
+        for (auto &i : automatas) {
+            auto new_prev_to_prev_transition = new EpsilonTransition(i->getBeginConnector());
+            prev_new_state->addTransition(new_prev_to_prev_transition);
+            prev_new_state = i->getEndConnector();
+            i->dismissConnectors();
+            delete i;
+        }
     }
 
     auto endState = new State();
@@ -296,7 +514,10 @@ void NFA_Automata::print() {
                 }
                 if(compaireTransition<EpsilonTransition>(i)) {
                     std::cout << count_state_[processing] << " - epsilon - " << count_state_[i->getNextState()] << std::endl;
-                } else {
+                } else if(compaireTransition<SymbolClassTransition>(i)) {
+                    auto transition = dynamic_cast<SymbolClassTransition*>(i);
+                    std::cout << count_state_[processing] << " - " << transition->getLabel() << " - " << count_state_[i->getNextState()] << std::endl;
+                } else if(compaireTransition<SymbolTransition>(i)) {
                     auto transition = dynamic_cast<SymbolTransition*>(i);
                     std::cout << count_state_[processing] << " - " << transition->getSymbol() << " - " << count_state_[i->getNextState()] << std::endl;
                 }
@@ -309,100 +530,39 @@ void NFA_Automata::print() {
 
 
 
-std::vector<State*> NFA_Automata::findAvailableStates(std::vector<State*> const& states, std::stack<std::pair<State*, std::string::const_iterator>> &stack, std::string::const_iterator const& iter) {
-    std::vector<State*> res;
-    std::stack<State*> wait_for_process;
-    std::set<State*> visited;
-
-    for (auto &i : states) {
-        wait_for_process.push(i);
-    }
-
-    while (!wait_for_process.empty()) {
-        State * working = wait_for_process.top();
-        wait_for_process.pop();
-
-        bool hasHighPriority = false;
-        std::vector<State *> lowPriority;
-        for ( auto &i : working->getTransitions()) {
-            if(compaireTransition<SymbolTransition>(i)) { res.push_back(working); continue; }
-            else {
-                if(!visited.count(i->getNextState())) {
-                    wait_for_process.push(i->getNextState());
-                    visited.insert(i->getNextState());
-                } else continue;
-
-            }
-            if(i->getNextState() == end_connector_) res.push_back(i->getNextState());
-            if(i->getPriority() == 1) { hasHighPriority = true; }
-            else lowPriority.push_back(i->getNextState());
-        }
-        if(hasHighPriority) {
-            std::reverse(lowPriority.begin(), lowPriority.end());
-            for(auto &i : lowPriority) stack.emplace(i, iter);
-        } else {
-            for(auto &i : lowPriority) wait_for_process.push(i);
-        }
-    }
-    return res;
-}
-
-std::vector<State*> NFA_Automata::step(std::vector<State*> & states, char sym) {
-    std::set<State*> visited;
-    std::vector<State*> stepStates;
-    for (auto &i : states) {
-        if(i == end_connector_) continue;
-        for (auto &b : i->getTransitions()) {
-            if(dynamic_cast<SymbolTransition*>(b)->getSymbol() == sym) {
-                if(visited.count(b->getNextState())) { continue; }
-                stepStates.push_back(b->getNextState());
-                visited.insert(b->getNextState());
-            }
-        }
-    }
-    return stepStates;
-}
-
-bool NFA_Automata::checkFinalStateAll(const std::vector<State *> &states) {
-    std::set<State*> visited;
-    std::vector<State*> res;
+std::map<State*, unsigned int> NFA_Automata::captureGroupTags(std::vector<std::string> &groups) const {
+    std::map<State*, unsigned int> tags;
+    std::map<std::string, unsigned int> indexes;
+    std::set<State *> visited;
     std::stack<State *> stack;
+    stack.push(begin_connector_);
 
-    for (auto &i : states) {
-        stack.push(i);
-    }
-
+    // Pre-order by priority visits capture groups in the order they are written in the pattern
     while (!stack.empty()) {
-        auto working = stack.top();
+        State * working = stack.top();
         stack.pop();
-        for (auto &i : working->getTransitions()) {
-            if(compaireTransition<EpsilonTransition>(i)) {
-                if (i->getNextState() == end_connector_) return true;
-                if (!visited.count(i->getNextState())) { stack.push(i->getNextState()); }
-            }
-        }
+        if(visited.count(working)) continue;
         visited.insert(working);
-    }
-    return false;
-}
 
-bool NFA_Automata::checkFinalStateNext(const std::vector<State *> &states) {
-    for (auto &i : states) {
-        if(i ==end_connector_) return true;
-    }
-
-    return false;
-}
-
-bool checkDownStep(std::vector<State *> const& states, std::vector<State *> const& next_states) {
-    for (auto &i : states) {
-        for (auto &b : next_states) {
-            for (auto &c : b->getTransitions()) {
-                if(c->getNextState() == i) return true;
+        auto capt_state = dynamic_cast<CaptureGroupState*>(working);
+        if(capt_state) {
+            std::string name = capt_state->getCaptureGroupName();
+            if(!indexes.count(name)) {
+                indexes[name] = groups.size();
+                groups.push_back(name);
             }
+            tags[working] = 2 * indexes[name] + (capt_state->isFinish() ? 1 : 0);
+        }
+
+        // Groups inside of the language copy behind a back reference are not captured
+        bool isReference = dynamic_cast<BackReferenceState*>(working);
+        auto ordered = priorityTransitions(working);
+        for (auto i = ordered.rbegin(); i != ordered.rend(); ++i) {
+            if(isReference && !compaireTransition<BackReferenceTransition>(*i)) continue;
+            if(!visited.count((*i)->getNextState())) stack.push((*i)->getNextState());
         }
     }
-    return false;
+    return tags;
 }
 
 const std::map<std::string, std::pair<bool, bool>> &CaptureGroupState::getInfo() const noexcept {
@@ -443,7 +603,10 @@ void NFA_Automata::printDOT(const std::string &file_name) {
                 }
                 if(compaireTransition<EpsilonTransition>(i)) {
                     file_ << count_state_[processing] << "->" << count_state_[i->getNextState()] << "[label = \"eps pr:" << int(i->getPriority()) << "\"]" << std::endl;
-                } else {
+                } else if(compaireTransition<SymbolClassTransition>(i)) {
+                    auto transition = dynamic_cast<SymbolClassTransition*>(i);
+                    file_ << count_state_[processing] << "->" << count_state_[i->getNextState()] << "[label = \"" << transition->getLabel() << "\"]" << std::endl;
+                } else if(compaireTransition<SymbolTransition>(i)) {
                     auto transition = dynamic_cast<SymbolTransition*>(i);
                     file_ << count_state_[processing] << "->" << count_state_[i->getNextState()] << "[label = \"" << transition->getSymbol() << "\"]" << std::endl;
                 }
@@ -7,6 +7,7 @@
 #include <map>
 #include <set>
 #include <stack>
+#include <bitset>
 
 class Transition;
 class NFA_Automata;
@@ -30,6 +31,8 @@ public:
     [[nodiscard]] bool isFinishState() noexcept;
     [[nodiscard]] std::vector<Transition*> const& getTransitions() const noexcept;
     [[nodiscard]] std::vector<Transition*> & getTransitions() noexcept;
+    // New state of the same kind and flags without transitions
+    [[nodiscard]] virtual State * copy() const;
     virtual ~State();
 };
 
@@ -49,9 +52,32 @@ public:
     std::string getCaptureGroupName();
     [[nodiscard]] bool isStart() const;
     [[nodiscard]] bool isFinish() const;
+    [[nodiscard]] State * copy() const override;
     ~CaptureGroupState() override = default;
 };
 
+class BackReferenceState : public State {
+    std::string group_name_;
+public:
+    explicit BackReferenceState(std::string group_name);
+    std::string getCaptureGroupName();
+    [[nodiscard]] State * copy() const override;
+    ~BackReferenceState() override = default;
+};
+
+// Counts repeats of one of 'symbols', the epsilon transitions are followed only
+// when the counter is equal to 'count'. The DFA can't be built with these states
+class CountingState : public State {
+    std::bitset<256> symbols_;
+    unsigned int count_;
+public:
+    CountingState(std::bitset<256> const& symbols, unsigned int count);
+    [[nodiscard]] std::bitset<256> const& getSymbols() const noexcept;
+    [[nodiscard]] unsigned int getCount() const noexcept;
+    [[nodiscard]] State * copy() const override;
+    ~CountingState() override = default;
+};
+
 class Transition {
 protected:
     char priority_ = 0;
@@ -61,6 +87,8 @@ public:
     explicit Transition(State * next_state);
     Transition(State * next_state, char priority);
     [[nodiscard]] State * getNextState() noexcept;
+    // Transition of the same kind leading to 'next_state'
+    [[nodiscard]] virtual Transition * copy(State * next_state) const;
     virtual ~Transition() noexcept;
 };
 
@@ -69,30 +97,86 @@ class SymbolTransition : public Transition {
 public:
     SymbolTransition(State * next_state_, char sym);
     [[nodiscard]] char getSymbol() const noexcept;
+    [[nodiscard]] Transition * copy(State * next_state) const override;
     ~SymbolTransition() override = default;
 };
 
+// Consumes one of the symbols of the set, made for a CharSetNode
+class SymbolClassTransition : public Transition {
+    std::bitset<256> symbols_;
+public:
+    SymbolClassTransition(State * next_state_, std::bitset<256> const& symbols);
+    [[nodiscard]] std::bitset<256> const& getSymbols() const noexcept;
+    [[nodiscard]] bool hasSymbol(char sym) const noexcept;
+    [[nodiscard]] std::string getLabel() const;
+    [[nodiscard]] Transition * copy(State * next_state) const override;
+    ~SymbolClassTransition() override = default;
+};
+
 class EpsilonTransition : public Transition {
 public:
     explicit EpsilonTransition(State * next_state_);
     explicit EpsilonTransition(State * next_state_, char priority);
+    [[nodiscard]] Transition * copy(State * next_state) const override;
 };
 
+// Consumes the string captured by the group, only the back reference matcher follows it
+class BackReferenceTransition : public Transition {
+public:
+    explicit BackReferenceTransition(State * next_state_);
+    [[nodiscard]] Transition * copy(State * next_state) const override;
+};
+
+// Transitions of the state ordered from the highest priority, the order of equal ones is kept
+std::vector<Transition*> priorityTransitions(State * state);
+
 class NFA_Automata {
     State * begin_connector_ = nullptr;
     State * end_connector_ = nullptr;
-    std::vector<State*> findAvailableStates(std::vector<State*> const& states, std::stack<std::pair<State*, std::string::const_iterator>> & stack, std::string::const_iterator const& iter);
-    std::vector<State*> step(std::vector<State*> & states, char a);
-    bool checkFinalStateAll(std::vector<State*> const& states);
-    bool checkFinalStateNext(std::vector<State*> const& states);
 public:
+    // 'end' is nullptr for automatas with flagged accepting states
     NFA_Automata(State * begin, State * end);
     [[nodiscard]] State * getBeginConnector() const noexcept;
     [[nodiscard]] State * getEndConnector() const noexcept;
+    // Capture groups in the order they are written in the pattern and the tag of every capture state
+    [[nodiscard]] std::map<State*, unsigned int> captureGroupTags(std::vector<std::string> & groups) const;
     void print();
     void printDOT(std::string const& file_name);
     bool addTransition(Transition * transition);
     void dismissConnectors();
+    [[nodiscard]] NFA_Automata * clone() const;
+};
+
+// Partition of the bytes that no symbol transition of the automata tells apart:
+// the subset construction makes one step per class instead of one per byte
+class ByteClasses {
+    unsigned short classes_[256] = {};
+    std::vector<std::vector<unsigned char>> members_;
+public:
+    explicit ByteClasses(const NFA_Automata * nfa_auto);
+    // Bytes that are in the same sets of 'labels'
+    explicit ByteClasses(std::vector<std::bitset<256>> const& labels);
+    [[nodiscard]] unsigned int size() const noexcept;
+    [[nodiscard]] unsigned int classOf(char sym) const noexcept;
+    // Members in increasing order, the first one represents the class
+    [[nodiscard]] std::vector<unsigned char> const& members(unsigned int byte_class) const noexcept;
+    // Classes of the bytes of the transition, nothing for non-symbol transitions
+    void transitionClasses(Transition * transition, std::vector<unsigned int> & classes) const;
+    ~ByteClasses() = default;
+};
+
+// States of an automata in index order with the indexes of transition targets:
+// every copy is made in one pass over the states without searching them.
+// The automata must not be changed while its copies are made
+class IndexedNFA {
+    std::vector<State*> states_;
+    std::vector<std::vector<unsigned int>> targets_;
+    unsigned int begin_ = 0;
+    unsigned int end_ = 0;
+public:
+    explicit IndexedNFA(const NFA_Automata * nfa_auto);
+    [[nodiscard]] NFA_Automata * copy() const;
+    ~IndexedNFA() = default;
 };
 
 #endif //LAB2_NFA_H
\ No newline at end of file
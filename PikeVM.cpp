@@ -0,0 +1,257 @@
+#include "PikeVM.h"
+#include <algorithm>
+#include <map>
+#include <stack>
+
+bool consumesSymbol(PikeInstruction const& instruction, std::vector<std::bitset<256>> const& classes, char sym) noexcept {
+    if(instruction.opcode_ == pike_opcode::symbol) return instruction.sym_ == sym;
+    if(instruction.opcode_ == pike_opcode::symbol_class) return classes[instruction.slot_].test(static_cast<unsigned char>(sym));
+    return false;
+}
+
+// PikeThreadList
+
+void PikeThreadList::reset(unsigned int program_size, unsigned int slots_count) {
+    sparse_.assign(program_size, 0);
+    dense_.assign(program_size, 0);
+    slots_.assign(static_cast<unsigned long>(program_size) * slots_count, tag_type::empty);
+    slots_count_ = slots_count;
+    size_ = 0;
+}
+
+void PikeThreadList::clear() noexcept { size_ = 0; }
+
+bool PikeThreadList::contains(unsigned int pc) const noexcept {
+    return sparse_[pc] < size_ && dense_[sparse_[pc]] == pc;
+}
+
+unsigned int PikeThreadList::insert(unsigned int pc) noexcept {
+    dense_[size_] = pc;
+    sparse_[pc] = size_;
+    return size_++;
+}
+
+unsigned int PikeThreadList::size() const noexcept { return size_; }
+
+unsigned int PikeThreadList::pc(unsigned int index) const noexcept { return dense_[index]; }
+
+tag_type::tag_value *PikeThreadList::slots(unsigned int index) noexcept {
+    return slots_.data() + static_cast<unsigned long>(index) * slots_count_;
+}
+
+// PikeVM
+
+void PikeVM::compile(const NFA_Automata *nfa_auto) {
+    *this = PikeVM();
+    auto tags = nfa_auto->captureGroupTags(groups_);
+    State * endState = nfa_auto->getEndConnector();
+
+    std::vector<State *> states;
+    std::map<State *, unsigned int> indexes;
+    std::stack<State *> stack;
+    stack.push(nfa_auto->getBeginConnector());
+    while (!stack.empty()) {
+        State * working = stack.top();
+        stack.pop();
+        if(indexes.count(working)) continue;
+        indexes[working] = states.size();
+        states.push_back(working);
+        for (auto &i : working->getTransitions()) {
+            if(!indexes.count(i->getNextState())) stack.push(i->getNextState());
+        }
+    }
+
+    // Every state becomes a block: [save] (split... symbol... | jump | symbol | match | fail),
+    // targets of other states are stored as state indexes and patched when all blocks are placed
+    std::vector<unsigned int> block_start(states.size());
+    std::vector<std::pair<unsigned int, bool>> patch_x;
+    for (unsigned int s = 0; s < states.size(); ++s) {
+        State * state = states[s];
+        block_start[s] = program_.size();
+
+        auto tag = tags.find(state);
+        if(tag != tags.end()) {
+            program_.push_back({pike_opcode::save, 0, static_cast<unsigned int>(program_.size() + 1), 0, tag->second});
+        }
+        if(state == endState) {
+            program_.push_back({pike_opcode::match, 0, 0, 0, 0});
+            continue;
+        }
+
+        std::vector<Transition *> alternatives;
+        for (auto &i : priorityTransitions(state)) {
+            if(compaireTransition<SymbolTransition>(i) || compaireTransition<SymbolClassTransition>(i) || compaireTransition<EpsilonTransition>(i)) {
+                alternatives.push_back(i);
+            }
+        }
+
+        if(alternatives.empty()) {
+            program_.push_back({pike_opcode::fail, 0, 0, 0, 0});
+        } else if(alternatives.size() == 1 && compaireTransition<EpsilonTransition>(alternatives.front())) {
+            program_.push_back({pike_opcode::jump, 0, indexes[alternatives.front()->getNextState()], 0, 0});
+            patch_x.emplace_back(program_.size() - 1, true);
+        } else {
+            // Splits point to symbol instructions placed after them or to blocks of epsilon targets
+            unsigned int splits = alternatives.size() - 1;
+            unsigned int symbol_pc = program_.size() + splits;
+            std::vector<std::pair<unsigned int, bool>> targets;
+            for (auto &i : alternatives) {
+                if(!compaireTransition<EpsilonTransition>(i)) targets.emplace_back(symbol_pc++, false);
+                else targets.emplace_back(indexes[i->getNextState()], true);
+            }
+            for (unsigned int i = 0; i < splits; ++i) {
+                unsigned int pc = program_.size();
+                PikeInstruction split = {pike_opcode::split, 0, targets[i].first, 0, 0};
+                if(targets[i].second) patch_x.emplace_back(pc, true);
+                if(i + 1 < splits) split.y_ = pc + 1;
+                else split.y_ = targets[i + 1].first;
+                program_.push_back(split);
+                if(i + 1 == splits && targets[i + 1].second) patch_x.emplace_back(pc, false);
+            }
+            for (auto &i : alternatives) {
+                auto sym_transition = dynamic_cast<SymbolTransition*>(i);
+                auto class_transition = dynamic_cast<SymbolClassTransition*>(i);
+                if(sym_transition) {
+                    program_.push_back({pike_opcode::symbol, sym_transition->getSymbol(), indexes[i->getNextState()], 0, 0});
+                } else if(class_transition) {
+                    unsigned int slot = classes_.size();
+                    classes_.push_back(class_transition->getSymbols());
+                    program_.push_back({pike_opcode::symbol_class, 0, indexes[i->getNextState()], 0, slot});
+                } else continue;
+                patch_x.emplace_back(program_.size() - 1, true);
+            }
+        }
+    }
+
+    for (auto &i : patch_x) {
+        if(i.second) program_[i.first].x_ = block_start[program_[i.first].x_];
+        else program_[i.first].y_ = block_start[program_[i.first].y_];
+    }
+    start_ = block_start[indexes[nfa_auto->getBeginConnector()]];
+
+    unsigned int slots_count = 2 * groups_.size();
+    current_.reset(program_.size(), slots_count);
+    next_.reset(program_.size(), slots_count);
+    working_slots_.assign(slots_count, tag_type::empty);
+}
+
+bool PikeVM::isEmpty() const noexcept { return program_.empty(); }
+
+const std::vector<std::string> &PikeVM::getGroups() const noexcept { return groups_; }
+
+unsigned long PikeVM::getProgramSize() const noexcept { return program_.size(); }
+
+std::vector<PikeInstruction> const &PikeVM::getProgram() const noexcept { return program_; }
+
+unsigned int PikeVM::getStartInstruction() const noexcept { return start_; }
+
+std::vector<std::bitset<256>> const &PikeVM::getClasses() const noexcept { return classes_; }
+
+void PikeVM::addThread(PikeThreadList &list, unsigned int pc, tag_type::tag_value pos, tag_type::tag_value *slots) {
+    unsigned int slots_count = 2 * groups_.size();
+    stack_.clear();
+    stack_.push_back({pc, 0, 0, false});
+
+    // Depth-first in priority order, a program counter is taken by the first thread reaching it
+    while (!stack_.empty()) {
+        AddFrame frame = stack_.back();
+        stack_.pop_back();
+        if(frame.restore_) { slots[frame.slot_] = frame.value_; continue; }
+        if(list.contains(frame.pc_)) continue;
+        unsigned int index = list.insert(frame.pc_);
+
+        PikeInstruction const& instruction = program_[frame.pc_];
+        switch (instruction.opcode_) {
+            case pike_opcode::jump:
+                stack_.push_back({instruction.x_, 0, 0, false});
+                break;
+            case pike_opcode::split:
+                stack_.push_back({instruction.y_, 0, 0, false});
+                stack_.push_back({instruction.x_, 0, 0, false});
+                break;
+            case pike_opcode::save:
+                stack_.push_back({0, instruction.slot_, slots[instruction.slot_], true});
+                slots[instruction.slot_] = pos;
+                stack_.push_back({instruction.x_, 0, 0, false});
+                break;
+            default:
+                std::copy(slots, slots + slots_count, list.slots(index));
+                break;
+        }
+    }
+}
+
+void PikeVM::startThreads(tag_type::tag_value pos) {
+    current_.clear();
+    std::fill(working_slots_.begin(), working_slots_.end(), tag_type::empty);
+    addThread(current_, start_, pos, working_slots_.data());
+}
+
+void PikeVM::step(char sym, tag_type::tag_value pos) {
+    unsigned int slots_count = 2 * groups_.size();
+    next_.clear();
+    for (unsigned int i = 0; i < current_.size(); ++i) {
+        PikeInstruction const& instruction = program_[current_.pc(i)];
+        if(!consumesSymbol(instruction, classes_, sym)) continue;
+        std::copy(current_.slots(i), current_.slots(i) + slots_count, working_slots_.begin());
+        addThread(next_, instruction.x_, pos + 1, working_slots_.data());
+    }
+    std::swap(current_, next_);
+}
+
+tag_type::match_tags PikeVM::match(std::string_view str, std::vector<tag_type::tag_value> &registers) {
+    if(isEmpty()) return std::nullopt;
+    startThreads(0);
+    for (unsigned long pos = 0; pos < str.size() && current_.size(); ++pos) {
+        step(str[pos], pos);
+    }
+
+    for (unsigned int i = 0; i < current_.size(); ++i) {
+        if(program_[current_.pc(i)].opcode_ == pike_opcode::match) {
+            registers.assign(current_.slots(i), current_.slots(i) + 2 * groups_.size());
+            return std::span<const tag_type::tag_value>(registers);
+        }
+    }
+    return std::nullopt;
+}
+
+tag_type::tag_value PikeVM::longestMatch(std::string_view str, tag_type::tag_value from) {
+    if(isEmpty()) return tag_type::empty;
+    tag_type::tag_value last_accept = tag_type::empty;
+    startThreads(from);
+    for (unsigned long pos = from; current_.size(); ++pos) {
+        for (unsigned int i = 0; i < current_.size(); ++i) {
+            if(program_[current_.pc(i)].opcode_ == pike_opcode::match) { last_accept = pos; break; }
+        }
+        if(pos == str.size()) break;
+        step(str[pos], pos);
+    }
+    return last_accept;
+}
+
+void PikeVM::matchEnds(std::string_view str, tag_type::tag_value from, std::vector<tag_type::tag_value> &ends) {
+    ends.clear();
+    if(isEmpty()) return;
+    startThreads(from);
+    for (unsigned long pos = from; current_.size(); ++pos) {
+        for (unsigned int i = 0; i < current_.size(); ++i) {
+            if(program_[current_.pc(i)].opcode_ == pike_opcode::match) { ends.push_back(pos); break; }
+        }
+        if(pos == str.size()) break;
+        step(str[pos], pos);
+    }
+}
+
+bool PikeVM::search(std::string_view str) {
+    if(isEmpty()) return false;
+    startThreads(0);
+    for (unsigned long pos = 0; ; ++pos) {
+        for (unsigned int i = 0; i < current_.size(); ++i) {
+            if(program_[current_.pc(i)].opcode_ == pike_opcode::match) return true;
+        }
+        if(pos == str.size()) return false;
+        step(str[pos], pos);
+        std::fill(working_slots_.begin(), working_slots_.end(), tag_type::empty);
+        addThread(current_, start_, pos + 1, working_slots_.data());
+    }
+}
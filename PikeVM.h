@@ -0,0 +1,93 @@
+#ifndef LAB2_PIKEVM_H
+#define LAB2_PIKEVM_H
+
+#include "NFA.h"
+#include "TaggedDFA.h"
+#include <vector>
+#include <bitset>
+#include <string>
+#include <string_view>
+
+namespace pike_opcode {
+    typedef unsigned char opcode;
+    inline constexpr opcode symbol = 0;
+    inline constexpr opcode split = 1;
+    inline constexpr opcode jump = 2;
+    inline constexpr opcode save = 3;
+    inline constexpr opcode match = 4;
+    inline constexpr opcode fail = 5;
+    // 'slot_' is the index of the symbols set
+    inline constexpr opcode symbol_class = 6;
+}
+
+// 'x_' is the next instruction (the preferred one for split), 'y_' is the second branch of split
+struct PikeInstruction {
+    pike_opcode::opcode opcode_;
+    char sym_;
+    unsigned int x_;
+    unsigned int y_;
+    unsigned int slot_;
+};
+
+// Symbol and symbol_class instructions consuming 'sym'
+[[nodiscard]] bool consumesSymbol(PikeInstruction const& instruction, std::vector<std::bitset<256>> const& classes, char sym) noexcept;
+
+// Sparse set of program counters with capture slots of every thread, cleared in O(1)
+class PikeThreadList {
+    std::vector<unsigned int> sparse_;
+    std::vector<unsigned int> dense_;
+    std::vector<tag_type::tag_value> slots_;
+    unsigned int size_ = 0;
+    unsigned int slots_count_ = 0;
+public:
+    void reset(unsigned int program_size, unsigned int slots_count);
+    void clear() noexcept;
+    [[nodiscard]] bool contains(unsigned int pc) const noexcept;
+    unsigned int insert(unsigned int pc) noexcept;
+    [[nodiscard]] unsigned int size() const noexcept;
+    [[nodiscard]] unsigned int pc(unsigned int index) const noexcept;
+    [[nodiscard]] tag_type::tag_value * slots(unsigned int index) noexcept;
+};
+
+// Thompson NFA simulation with priority-ordered threads: O(n * m) for any pattern
+class PikeVM {
+    struct AddFrame {
+        unsigned int pc_;
+        unsigned int slot_;
+        tag_type::tag_value value_;
+        bool restore_;
+    };
+
+    std::vector<PikeInstruction> program_;
+    std::vector<std::bitset<256>> classes_;
+    std::vector<std::string> groups_;
+    unsigned int start_ = 0;
+    PikeThreadList current_;
+    PikeThreadList next_;
+    std::vector<tag_type::tag_value> working_slots_;
+    std::vector<AddFrame> stack_;
+
+    void addThread(PikeThreadList & list, unsigned int pc, tag_type::tag_value pos, tag_type::tag_value * slots);
+    void startThreads(tag_type::tag_value pos);
+    void step(char sym, tag_type::tag_value pos);
+public:
+    PikeVM() = default;
+    void compile(const NFA_Automata * nfa_auto);
+    [[nodiscard]] bool isEmpty() const noexcept;
+    [[nodiscard]] std::vector<std::string> const& getGroups() const noexcept;
+    [[nodiscard]] unsigned long getProgramSize() const noexcept;
+    [[nodiscard]] std::vector<PikeInstruction> const& getProgram() const noexcept;
+    [[nodiscard]] unsigned int getStartInstruction() const noexcept;
+    [[nodiscard]] std::vector<std::bitset<256>> const& getClasses() const noexcept;
+    // Same contract as TaggedDFA_Automata::match
+    [[nodiscard]] tag_type::match_tags match(std::string_view str, std::vector<tag_type::tag_value> & registers);
+    // End of the longest match starting at 'from' or tag_type::empty
+    [[nodiscard]] tag_type::tag_value longestMatch(std::string_view str, tag_type::tag_value from);
+    // Every end of a match starting at 'from' in increasing order
+    void matchEnds(std::string_view str, tag_type::tag_value from, std::vector<tag_type::tag_value> & ends);
+    // Some substring of the string is in the language: one pass with a new lowest-priority thread at every position
+    [[nodiscard]] bool search(std::string_view str);
+    ~PikeVM() = default;
+};
+
+#endif //LAB2_PIKEVM_H
@@ -0,0 +1,187 @@
+#include "TaggedDFA.h"
+#include <algorithm>
+#include <queue>
+
+bool hasSymbolTransition(State * state) {
+    for (auto &i : state->getTransitions()) {
+        if(compaireTransition<SymbolTransition>(i) || compaireTransition<SymbolClassTransition>(i)) return true;
+    }
+    return false;
+}
+
+std::vector<TaggedItem> TaggedDFA_Automata::closure(std::vector<std::pair<State*, unsigned int>> const& sources, State * endState) const {
+    std::vector<TaggedItem> items;
+    std::set<State *> visited;
+
+    // The first path reaching a state has the highest priority, later ones are dropped
+    for (auto &source : sources) {
+        std::stack<std::pair<State *, std::vector<unsigned int>>> stack;
+        stack.push({source.first, {}});
+        while (!stack.empty()) {
+            auto working = stack.top();
+            stack.pop();
+            if(visited.count(working.first)) continue;
+            visited.insert(working.first);
+
+            auto tag = tags_.find(working.first);
+            if(tag != tags_.end()) working.second.push_back(tag->second);
+            if(working.first == endState || hasSymbolTransition(working.first)) {
+                items.push_back({working.first, source.second, working.second});
+            }
+
+            auto ordered = priorityTransitions(working.first);
+            for (auto i = ordered.rbegin(); i != ordered.rend(); ++i) {
+                if(compaireTransition<EpsilonTransition>(*i) && !visited.count((*i)->getNextState())) {
+                    stack.push({(*i)->getNextState(), working.second});
+                }
+            }
+        }
+    }
+    return items;
+}
+
+TaggedTransition TaggedDFA_Automata::addCommands(std::vector<TaggedItem> const& items, unsigned int next_state) {
+    bool identity = true;
+    for (unsigned int i = 0; i < items.size(); ++i) {
+        if(items[i].src_item_ != i || !items[i].tags_.empty()) { identity = false; break; }
+    }
+
+    TaggedTransition transition;
+    transition.next_state_ = next_state;
+    transition.commands_begin_ = commands_.size();
+    if(!identity) {
+        for (unsigned int i = 0; i < items.size(); ++i) {
+            unsigned int tags_begin = tag_list_.size();
+            tag_list_.insert(tag_list_.end(), items[i].tags_.begin(), items[i].tags_.end());
+            commands_.push_back({i, items[i].src_item_, tags_begin, static_cast<unsigned int>(tag_list_.size())});
+        }
+    }
+    transition.commands_end_ = commands_.size();
+    return transition;
+}
+
+bool TaggedDFA_Automata::synthesisFromNFA(const NFA_Automata *nfa_auto, SynthesisBudget const& budget) {
+    *this = TaggedDFA_Automata();
+    tags_ = nfa_auto->captureGroupTags(groups_);
+    if(groups_.empty()) return true;
+
+    State * endState = nfa_auto->getEndConnector();
+    ByteClasses byte_classes(nfa_auto);
+    std::vector<unsigned int> edge_classes;
+    std::map<std::vector<State*>, unsigned int> collector;
+    std::vector<std::vector<State*>> kernels;
+    std::queue<unsigned int> determenisticStates;
+
+    auto intern = [&](std::vector<TaggedItem> const& items) {
+        std::vector<State*> kernel;
+        kernel.reserve(items.size());
+        for (auto &i : items) kernel.push_back(i.state_);
+        auto found = collector.find(kernel);
+        if(found != collector.end()) return found->second;
+        unsigned long memory = (kernels.size() + 1) * 256 * sizeof(TaggedTransition) + commands_.size() * sizeof(TagCommand);
+        if(budget.exceeded(kernels.size() + 1, memory)) return tag_type::none;
+
+        unsigned int id = kernels.size();
+        unsigned int final_item = tag_type::none;
+        for (unsigned int i = 0; i < kernel.size(); ++i) {
+            if(kernel[i] == endState) { final_item = i; break; }
+        }
+        max_items_ = std::max<unsigned int>(max_items_, kernel.size());
+        collector[kernel] = id;
+        kernels.push_back(kernel);
+        final_items_.push_back(final_item);
+        transitions_.resize(transitions_.size() + 256);
+        determenisticStates.push(id);
+        return id;
+    };
+
+    auto startItems = closure({{nfa_auto->getBeginConnector(), tag_type::none}}, endState);
+    unsigned int start = intern(startItems);
+    if(start == tag_type::none) {
+        *this = TaggedDFA_Automata();
+        return false;
+    }
+    initial_ = addCommands(startItems, start);
+
+    while (!determenisticStates.empty()) {
+        unsigned int working = determenisticStates.front();
+        determenisticStates.pop();
+
+        // Bytes of one class have the same items and commands, the class is determinized once
+        std::map<unsigned int, std::vector<std::pair<State*, unsigned int>>> symbolStates;
+        auto kernel = kernels[working];
+        for (unsigned int i = 0; i < kernel.size(); ++i) {
+            for (auto &b : kernel[i]->getTransitions()) {
+                byte_classes.transitionClasses(b, edge_classes);
+                for (auto &c : edge_classes) symbolStates[c].push_back({b->getNextState(), i});
+            }
+        }
+
+        for (auto &i : symbolStates) {
+            auto items = closure(i.second, endState);
+            unsigned int next_state = intern(items);
+            if(next_state == tag_type::none) {
+                *this = TaggedDFA_Automata();
+                return false;
+            }
+            TaggedTransition transition = addCommands(items, next_state);
+            for (auto &sym : byte_classes.members(i.first)) transitions_[working * 256 + sym] = transition;
+        }
+    }
+    return true;
+}
+
+void TaggedDFA_Automata::applyCommands(TaggedTransition const& transition,
+                                       tag_type::tag_value const* from,
+                                       tag_type::tag_value * to,
+                                       tag_type::tag_value pos) const {
+    unsigned long tags_count = 2 * groups_.size();
+    for (unsigned int i = transition.commands_begin_; i < transition.commands_end_; ++i) {
+        TagCommand const& command = commands_[i];
+        tag_type::tag_value * row = to + command.dst_item_ * tags_count;
+        if(command.src_item_ == tag_type::none) std::fill(row, row + tags_count, tag_type::empty);
+        else std::copy(from + command.src_item_ * tags_count, from + (command.src_item_ + 1) * tags_count, row);
+        for (unsigned int t = command.tags_begin_; t < command.tags_end_; ++t) {
+            row[tag_list_[t]] = pos;
+        }
+    }
+}
+
+tag_type::match_tags TaggedDFA_Automata::match(std::string_view str, std::vector<tag_type::tag_value> & registers) const {
+    if(isEmpty()) return std::nullopt;
+    unsigned long tags_count = 2 * groups_.size();
+    unsigned long half = max_items_ * tags_count;
+    if(registers.size() < 2 * half) registers.resize(2 * half);
+    tag_type::tag_value * current = registers.data();
+    tag_type::tag_value * next = registers.data() + half;
+
+    applyCommands(initial_, next, current, 0);
+    unsigned int state = initial_.next_state_;
+
+    for (unsigned long pos = 0; pos < str.size(); ++pos) {
+        TaggedTransition const& transition = transitions_[state * 256 + static_cast<unsigned char>(str[pos])];
+        if(transition.next_state_ == tag_type::none) return std::nullopt;
+        if(transition.commands_begin_ != transition.commands_end_) {
+            applyCommands(transition, current, next, pos + 1);
+            std::swap(current, next);
+        }
+        state = transition.next_state_;
+    }
+
+    unsigned int final_item = final_items_[state];
+    if(final_item == tag_type::none) return std::nullopt;
+    return std::span<const tag_type::tag_value>(current + final_item * tags_count, tags_count);
+}
+
+unsigned int TaggedDFA_Automata::getGroupIndex(std::string_view name) const {
+    for (unsigned int i = 0; i < groups_.size(); ++i) {
+        if(groups_[i] == name) return i;
+    }
+    throw std::logic_error("Capture group is not founded");
+}
+
+bool TaggedDFA_Automata::isEmpty() const noexcept { return groups_.empty(); }
+
+const std::vector<std::string> &TaggedDFA_Automata::getGroups() const noexcept { return groups_; }
+
+unsigned int TaggedDFA_Automata::getStatesCount() const noexcept { return final_items_.size(); }
@@ -0,0 +1,70 @@
+#ifndef LAB2_TAGGEDDFA_H
+#define LAB2_TAGGEDDFA_H
+
+#include "NFA.h"
+#include "DFA.h"
+#include <vector>
+#include <string>
+#include <map>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace tag_type {
+    typedef unsigned long tag_value;
+    inline constexpr tag_value empty = static_cast<tag_value>(-1);
+    inline constexpr unsigned int none = static_cast<unsigned int>(-1);
+    // Tags of a match, two per capture group, or nothing if there is no match
+    typedef std::optional<std::span<const tag_value>> match_tags;
+}
+
+// Register row of item 'dst_item_' is copied from row 'src_item_' of the previous
+// step, then tags [tags_begin_, tags_end_) of the tag list are set to the current position
+struct TagCommand {
+    unsigned int dst_item_;
+    unsigned int src_item_;
+    unsigned int tags_begin_;
+    unsigned int tags_end_;
+};
+
+struct TaggedTransition {
+    unsigned int next_state_ = tag_type::none;
+    unsigned int commands_begin_ = 0;
+    unsigned int commands_end_ = 0;
+};
+
+struct TaggedItem {
+    State * state_;
+    unsigned int src_item_;
+    std::vector<unsigned int> tags_;
+};
+
+// Laurikari-style tagged DFA: a state is the priority-ordered list of NFA states (items),
+// every item owns a row of registers with one value per tag (two tags per capture group)
+class TaggedDFA_Automata {
+    std::vector<std::string> groups_;
+    std::map<State*, unsigned int> tags_;
+    std::vector<TaggedTransition> transitions_;
+    std::vector<unsigned int> final_items_;
+    std::vector<TagCommand> commands_;
+    std::vector<unsigned int> tag_list_;
+    TaggedTransition initial_;
+    unsigned int max_items_ = 0;
+
+    [[nodiscard]] std::vector<TaggedItem> closure(std::vector<std::pair<State*, unsigned int>> const& sources, State * endState) const;
+    TaggedTransition addCommands(std::vector<TaggedItem> const& items, unsigned int next_state);
+    void applyCommands(TaggedTransition const& transition, tag_type::tag_value const* from, tag_type::tag_value * to, tag_type::tag_value pos) const;
+public:
+    TaggedDFA_Automata() = default;
+    // Returns false and keeps the automata empty if the budget is exceeded
+    bool synthesisFromNFA(const NFA_Automata * nfa_auto, SynthesisBudget const& budget = SynthesisBudget());
+    [[nodiscard]] bool isEmpty() const noexcept;
+    [[nodiscard]] std::vector<std::string> const& getGroups() const noexcept;
+    [[nodiscard]] unsigned int getStatesCount() const noexcept;
+    [[nodiscard]] unsigned int getGroupIndex(std::string_view name) const;
+    // 'registers' is a scratch buffer reused between calls, the result views the tags of the match inside it
+    [[nodiscard]] tag_type::match_tags match(std::string_view str, std::vector<tag_type::tag_value> & registers) const;
+    ~TaggedDFA_Automata() = default;
+};
+
+#endif //LAB2_TAGGEDDFA_H
@@ -0,0 +1,198 @@
+#include <iostream>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include <algorithm>
+#include "myRegex.h"
+
+// lab2_grep [-s] PATTERN PATH...
+// Prints 'path:line:text' for every line with a match of PATTERN, in the order of the files
+// and lines. Lines are matched one by one, so a match never spans a line end. Directories
+// are searched recursively, -s prints the throughput
+
+namespace grep_options {
+    // Big files are split into chunks of about this size at line ends
+    inline constexpr unsigned long chunk_size = 8ul << 20;
+}
+
+struct GrepTask {
+    unsigned long file_;
+    std::string_view text_;
+    unsigned long offset_;
+};
+
+struct GrepResult {
+    // Hits as the line in the chunk and the line text
+    std::vector<std::pair<unsigned long, std::string_view>> hits_;
+    unsigned long lines_ = 0;
+    // Message of the exception thrown by the chunk, the hits are not complete then
+    std::string error_;
+    bool done_ = false;
+};
+
+// Every worker owns a deque of tasks: it takes its own tasks from the front and steals
+// from the back of the others when its deque is empty
+class WorkStealingPool {
+    struct Queue {
+        std::mutex mutex_;
+        std::deque<unsigned long> tasks_;
+    };
+    std::vector<Queue> queues_;
+public:
+    explicit WorkStealingPool(unsigned int workers) : queues_(workers) {}
+
+    void push(unsigned int worker, unsigned long task) { queues_[worker].tasks_.push_back(task); }
+
+    bool pop(unsigned int worker, unsigned long & task) {
+        {
+            std::lock_guard lock(queues_[worker].mutex_);
+            if(!queues_[worker].tasks_.empty()) {
+                task = queues_[worker].tasks_.front();
+                queues_[worker].tasks_.pop_front();
+                return true;
+            }
+        }
+        for (unsigned int i = 1; i < queues_.size(); ++i) {
+            Queue & victim = queues_[(worker + i) % queues_.size()];
+            std::lock_guard lock(victim.mutex_);
+            if(!victim.tasks_.empty()) {
+                task = victim.tasks_.back();
+                victim.tasks_.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+void collectFiles(std::string const& path, std::vector<std::string> & files) {
+    if(!std::filesystem::is_directory(path)) { files.push_back(path); return; }
+    std::vector<std::string> found;
+    for (auto &i : std::filesystem::recursive_directory_iterator(path, std::filesystem::directory_options::skip_permission_denied)) {
+        if(i.is_regular_file()) found.push_back(i.path().string());
+    }
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+}
+
+void splitChunks(unsigned long file, std::string_view text, std::vector<GrepTask> & tasks) {
+    unsigned long begin = 0;
+    do {
+        unsigned long end = std::min(text.size(), begin + grep_options::chunk_size);
+        if(end < text.size()) {
+            unsigned long line_end = text.find('\n', end);
+            end = line_end == std::string_view::npos ? text.size() : line_end + 1;
+        }
+        tasks.push_back({file, text.substr(begin, end - begin), begin});
+        begin = end;
+    } while (begin < text.size());
+}
+
+// The lines are counted first, so the numbers of the next chunks are right even if the matching throws
+void grepChunk(myRegex & regex, GrepTask const& task, GrepResult & result) {
+    std::string_view text = task.text_;
+    result.lines_ = std::count(text.begin(), text.end(), '\n') + (!text.empty() && text.back() != '\n');
+    unsigned long line = 0;
+    unsigned long line_begin = 0;
+    while (line_begin < text.size()) {
+        unsigned long line_end = text.find('\n', line_begin);
+        if(line_end == std::string_view::npos) line_end = text.size();
+        std::string_view line_text = text.substr(line_begin, line_end - line_begin);
+        if(regex.search(line_text)) result.hits_.emplace_back(line, line_text);
+        ++line;
+        line_begin = line_end + 1;
+    }
+}
+
+int main(int argc, char ** argv) {
+    bool stats = false;
+    int arg = 1;
+    if(arg < argc && std::string_view(argv[arg]) == "-s") { stats = true; ++arg; }
+    if(argc - arg < 2) {
+        std::cerr << "usage: lab2_grep [-s] PATTERN PATH..." << std::endl;
+        return 2;
+    }
+    std::string pattern = argv[arg++];
+
+    std::vector<std::string> files;
+    std::vector<MappedFile> mapped;
+    std::vector<GrepTask> tasks;
+    unsigned int workers = std::max(1u, std::thread::hardware_concurrency());
+    // The copies share the compiled tables, every worker owns the scratch of its copy only
+    std::vector<myRegex> matchers;
+    try {
+        for (; arg < argc; ++arg) collectFiles(argv[arg], files);
+        for (unsigned long i = 0; i < files.size(); ++i) {
+            mapped.emplace_back(files[i]);
+            if(!mapped.back().view().empty()) splitChunks(i, mapped.back().view(), tasks);
+        }
+        matchers.assign(workers, myRegex(pattern, syntax_option_type::optimize));
+    } catch (std::exception const& error) {
+        std::cerr << "lab2_grep: " << error.what() << std::endl;
+        return 2;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    WorkStealingPool pool(workers);
+    for (unsigned long i = 0; i < tasks.size(); ++i) pool.push(i % workers, i);
+
+    std::vector<GrepResult> results(tasks.size());
+    std::mutex results_mutex;
+    std::condition_variable results_ready;
+    std::vector<std::thread> threads;
+    for (unsigned int w = 0; w < workers; ++w) {
+        threads.emplace_back([&, w]() {
+            unsigned long task;
+            while (pool.pop(w, task)) {
+                GrepResult result;
+                try {
+                    grepChunk(matchers[w], tasks[task], result);
+                } catch (std::exception const& error) {
+                    result.error_ = error.what();
+                }
+                result.done_ = true;
+                std::lock_guard lock(results_mutex);
+                results[task] = std::move(result);
+                results_ready.notify_all();
+            }
+        });
+    }
+
+    // Chunks are printed in order, the line numbers go on from the previous chunks of the file
+    unsigned long hits = 0;
+    unsigned long bytes = 0;
+    bool failed = false;
+    unsigned long line_base = 0;
+    for (unsigned long i = 0; i < tasks.size(); ++i) {
+        GrepResult result;
+        {
+            std::unique_lock lock(results_mutex);
+            results_ready.wait(lock, [&]() { return results[i].done_; });
+            result = std::move(results[i]);
+        }
+        if(i == 0 || tasks[i].file_ != tasks[i - 1].file_) line_base = 0;
+        for (auto &hit : result.hits_) {
+            std::cout << files[tasks[i].file_] << ':' << line_base + hit.first + 1 << ':' << hit.second << '\n';
+        }
+        if(!result.error_.empty()) {
+            std::cerr << "lab2_grep: " << files[tasks[i].file_] << ": " << result.error_ << std::endl;
+            failed = true;
+        }
+        line_base += result.lines_;
+        hits += result.hits_.size();
+        bytes += tasks[i].text_.size();
+    }
+    for (auto &i : threads) i.join();
+    std::cout.flush();
+
+    if(stats) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << files.size() << " files, " << bytes << " bytes, " << hits << " lines in " << seconds << " s, "
+                  << bytes / seconds / (1 << 20) << " MB/s with " << workers << " threads" << std::endl;
+    }
+    if(failed) return 2;
+    return hits ? 0 : 1;
+}
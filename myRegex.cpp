@@ -1,32 +1,421 @@
 #include "myRegex.h"
+#include <algorithm>
+
+// engine_type
+
+std::string_view engine_type::name(engine_type::engine type) noexcept {
+    switch (type) {
+        case engine_type::dfa: return "dfa";
+        case engine_type::lazy_dfa: return "lazy_dfa";
+        case engine_type::pike_vm: return "pike_vm";
+        case engine_type::tagged_dfa: return "tagged_dfa";
+        case engine_type::backreference: return "backreference";
+        case engine_type::counting_nfa: return "counting_nfa";
+        case engine_type::aho_corasick: return "aho_corasick";
+        default: return "none";
+    }
+}
+
+// mySmatch
+
+std::string_view mySmatch::operator[](size_t index) const {
+    if(index >= spans_.size()) throw std::logic_error("Capture group is not founded");
+    if(!matched(index)) return {};
+    return { str_ + spans_[index].first, spans_[index].second - spans_[index].first };
+}
+
+std::string_view mySmatch::operator[](std::string_view name) const {
+    if(names_) {
+        for (size_t i = 0; i < names_->size(); ++i) {
+            if((*names_)[i] == name) return (*this)[i];
+        }
+    }
+    throw std::logic_error("Capture group is not founded");
+}
+
+bool mySmatch::matched(size_t index) const {
+    if(index >= spans_.size()) throw std::logic_error("Capture group is not founded");
+    return spans_[index].first != smatch_type::npos;
+}
+
+std::string_view mySmatch::name(size_t index) const {
+    if(!names_ || index >= names_->size()) throw std::logic_error("Capture group is not founded");
+    return (*names_)[index];
+}
+
+std::string_view mySmatch::str() const {
+    if(match_.first == smatch_type::npos) return {};
+    return { str_ + match_.first, match_.second - match_.first };
+}
+
+size_t mySmatch::position() const noexcept { return match_.first; }
+
+size_t mySmatch::length() const noexcept { return match_.second - match_.first; }
+
+mySmatch::const_iterator mySmatch::begin() const noexcept { return { this, 0 }; }
+
+mySmatch::const_iterator mySmatch::end() const noexcept { return { this, spans_.size() }; }
+
+size_t mySmatch::size() const noexcept { return spans_.size(); }
+
+// myRegex
 
 myRegex::myRegex(const std::string &str) {
+    compile(str);
+}
+
+myRegex myRegex::fromLiterals(std::vector<std::string> const& literals, CompileOptions const& options) {
+    myRegex regex;
+    regex.options_ = options;
+    regex.automata_.synthesisFromLiterals(literals);
+    regex.resetToDFA();
+    if(options.literal_search_ && std::none_of(literals.begin(), literals.end(), [](std::string const& i) { return i.empty(); })) {
+        auto literal = std::make_shared<AhoCorasick>();
+        literal->compile(literals);
+        if(!literal->isEmpty()) regex.literal_automata_ = std::move(literal);
+    }
+    return regex;
+}
+
+// With 'optimize' the DFA is minimized before its table is compiled
+void myRegex::compile(const std::string &str, bool optimize) {
+    pattern_ = str;
+    group_names_.reset();
     PatternString pattern(str);
-    NFA_Automata * NFA =  pattern.generateSyntaxTree().generateNFA();
-    automata_.synthesisFromNFA(NFA);
+    SyntaxTree tree = pattern.generateSyntaxTree();
+    std::vector<std::string> literals;
+    if(options_.literal_search_ && tree.literals(literals)) {
+        // The DFA of the strings is minimal already
+        automata_.synthesisFromLiterals(literals);
+        resetToDFA();
+        backreference_matcher_ = BackReferenceMatcher();
+        auto literal = std::make_shared<AhoCorasick>();
+        literal->compile(literals);
+        if(!literal->isEmpty()) literal_automata_ = std::move(literal);
+        return;
+    }
+    if(options_.simplify_) tree.simplify();
+    if(options_.counting_threshold_ && tree.markCountingRepeats(options_.counting_threshold_)) {
+        NFA_Automata * NFA = tree.generateNFA();
+        counting_automata_.synthesisFromNFA(NFA);
+        engine_ = engine_type::counting_nfa;
+        return;
+    }
+    if((options_.derivative_dfa_ || options_.position_nfa_) && !tree.hasCaptureGroups()) {
+        SynthesisBudget budget(options_.max_dfa_states_, options_.max_memory_, options_.max_compile_time_);
+        bool complete;
+        if(options_.derivative_dfa_) {
+            DerivativeBuilder builder;
+            automata_ = DFA_Automata();
+            complete = builder.synthesis(tree.generateTerm(builder), automata_, budget);
+        } else {
+            complete = automata_.synthesisFromNFA(tree.generatePositionNFA(), budget, options_.merge_kernels_, options_.synthesis_threads_);
+        }
+        resetToDFA(optimize);
+        backreference_matcher_ = BackReferenceMatcher();
+        if(complete) return;
+        // The Pike VM needs the end connector of the Thompson automata
+        engine_ = engine_type::pike_vm;
+        fallbackFromNFA(tree.generateNFA());
+        return;
+    }
+    NFA_Automata * NFA = tree.generateNFA();
+    synthesisFromNFA(NFA, optimize);
+}
+
+// With back references the DFA accepts a superset of the language and works as a prefilter.
+// Automatas that are out of the budget are replaced with the lazy DFA and the Pike VM
+void myRegex::synthesisFromNFA(const NFA_Automata *nfa_auto, bool optimize) {
+    SynthesisBudget budget(options_.max_dfa_states_, options_.max_memory_, options_.max_compile_time_);
+    bool complete = automata_.synthesisFromNFA(nfa_auto, budget, options_.merge_kernels_, options_.synthesis_threads_);
+    backreference_matcher_.synthesisFromNFA(nfa_auto);
+    tagged_automata_ = TaggedDFA_Automata();
+    if(complete && backreference_matcher_.isEmpty()) complete = tagged_automata_.synthesisFromNFA(nfa_auto, budget);
+    lazy_automata_ = LazyDFA_Automata();
+    counting_automata_ = CountingNFA_Automata();
+    compileTable(optimize);
+    engine_ = hasDFA() ? engine_type::dfa : engine_type::pike_vm;
+    if(complete) { pike_vm_ = PikeVM(); return; }
+    fallbackFromNFA(nfa_auto);
+}
+
+void myRegex::fallbackFromNFA(const NFA_Automata *nfa_auto) {
+    pike_vm_.compile(nfa_auto);
+    // A state limit under the minimum cache is raised to it, only the memory rules the lazy DFA out
+    unsigned long memory_states = options_.max_memory_ / LazyDFA_Automata::stateMemory();
+    if(!hasDFA() && options_.lazy_dfa_ && memory_states >= lazy_dfa_options::min_cache_states) {
+        unsigned long cache_states = std::max(std::min(options_.max_dfa_states_, memory_states), lazy_dfa_options::min_cache_states);
+        lazy_automata_.synthesisFromProgram(pike_vm_, cache_states);
+        engine_ = engine_type::lazy_dfa;
+    }
+}
+
+// Language operations produce a plain DFA without capture groups
+void myRegex::resetToDFA(bool optimize) {
+    group_names_.reset();
+    compileTable(optimize);
+    tagged_automata_ = TaggedDFA_Automata();
+    lazy_automata_ = LazyDFA_Automata();
+    counting_automata_ = CountingNFA_Automata();
+    pike_vm_ = PikeVM();
+    literal_automata_.reset();
+    engine_ = engine_type::dfa;
+}
+
+void myRegex::compileTable(bool optimize) {
+    if(optimize && hasDFA()) optimizeDFA();
+    auto table = std::make_shared<CompiledDFA>();
+    table->compile(automata_, options_.sparse_degree_, options_.max_memory_, options_.max_compile_time_);
+    table_ = std::move(table);
+}
+
+void myRegex::optimizeDFA() {
+    if(options_.moore_minimization_) { minimization_rounds_ = automata_.optimizeParallel(options_.minimization_threads_); return; }
+    minimization_rounds_.clear();
+    automata_.optimize();
+}
+
+void myRegex::reorderStates(std::span<const std::string_view> samples) {
+    // Other copies keep the old order
+    auto table = std::make_shared<CompiledDFA>(*table_);
+    if(samples.empty()) table->reorderByBreadth();
+    else table->reorderByProfile(samples);
+    table_ = std::move(table);
+}
+
+std::vector<MinimizationRound> const &myRegex::minimizationRounds() const noexcept { return minimization_rounds_; }
+
+bool myRegex::hasDFA() const noexcept { return automata_.getStart(); }
+
+std::vector<std::string> const &myRegex::groups() const noexcept {
+    if(!backreference_matcher_.isEmpty()) return backreference_matcher_.getGroups();
+    if(!pike_vm_.isEmpty()) return pike_vm_.getGroups();
+    return tagged_automata_.getGroups();
+}
+
+bool myRegex::match(const std::string &str_) { return accepts(str_); }
+
+bool myRegex::accepts(std::string_view str_) {
+    bool isAccept;
+    if(engine_ == engine_type::counting_nfa) {
+        return counting_automata_.match(str_);
+    } else if(engine_ == engine_type::lazy_dfa) {
+        isAccept = lazy_automata_.match(str_);
+    } else if(engine_ == engine_type::pike_vm) {
+        isAccept = pike_vm_.match(str_, registers_).has_value();
+    } else {
+        isAccept = table_->match(str_);
+    }
+
+    if(!isAccept || backreference_matcher_.isEmpty()) return isAccept;
+    return backreference_matcher_.match(str_, registers_).has_value();
+}
+
+std::vector<bool> myRegex::matchBatch(std::span<const std::string_view> strs) {
+    std::vector<bool> results;
+    if(engine_ == engine_type::dfa && backreference_matcher_.isEmpty()) {
+        table_->matchBatch(strs, results);
+        return results;
+    }
+    results.reserve(strs.size());
+    for (auto &i : strs) results.push_back(accepts(i));
+    return results;
+}
+
+bool myRegex::matchPrefix(const std::string &str_) {
+    if(engine_ == engine_type::dfa && backreference_matcher_.isEmpty()) return table_->matchPrefix(str_);
+    return longestMatch(str_, 0) != smatch_type::npos;
 }
 
-bool myRegex::match(const std::string &str_) {
-    automata_.start();
-    bool isAccept = automata_.isAccept();
+bool myRegex::search(std::string_view str_) {
+    if(engine_ == engine_type::counting_nfa) return counting_automata_.search(str_);
+    bool found;
+    if(engine_ == engine_type::lazy_dfa) found = lazy_automata_.search(str_);
+    else if(engine_ == engine_type::pike_vm) found = pike_vm_.search(str_);
+    else found = table_->search(str_);
+    if(!found || backreference_matcher_.isEmpty()) return found;
+
+    // The prefilter saw some match. The DFA gives all the starts of its matches in one pass,
+    // only they are searched with back references
+    if(engine_ == engine_type::dfa) {
+        table_->matchStarts(str_, starts_);
+        for (auto &start : starts_) {
+            backreference_matcher_.matchEnds(str_, start, ends_);
+            if(!ends_.empty()) return true;
+        }
+        return false;
+    }
+    for (size_t pos = 0; pos <= str_.size(); ++pos) {
+        if(longestMatch(str_, pos) != smatch_type::npos) return true;
+    }
+    return false;
+}
+
+bool myRegex::fillSmatch(std::string_view str, size_t from, size_t to, mySmatch &smatch) {
+    smatch.str_ = str.data();
+    smatch.match_ = {from, to};
+    smatch.spans_.clear();
+
+    if(!group_names_) group_names_ = std::make_shared<const std::vector<std::string>>(groups());
+    smatch.names_ = group_names_;
 
-    for (auto &i : str_) {
-        bool next = automata_.next_state(i);
-        if(!next) return false;
-        isAccept = automata_.isAccept();
+    tag_type::match_tags tags;
+    if(!backreference_matcher_.isEmpty()) {
+        tags = backreference_matcher_.match(str.substr(from, to - from), registers_);
+    } else if(!pike_vm_.isEmpty()) {
+        if(smatch.names_->empty()) return true;
+        tags = pike_vm_.match(str.substr(from, to - from), registers_);
+    } else {
+        if(tagged_automata_.isEmpty()) return true;
+        tags = tagged_automata_.match(str.substr(from, to - from), registers_);
     }
+    if(!tags) return false;
 
-    return  isAccept;
+    size_t groups_count = smatch.names_->size();
+    for (size_t i = 0; i < groups_count; ++i) {
+        tag_type::tag_value start = (*tags)[2 * i];
+        tag_type::tag_value finish = (*tags)[2 * i + 1];
+        if(start != tag_type::empty && finish != tag_type::empty && start <= finish) {
+            smatch.spans_.emplace_back(from + start, from + finish);
+        } else {
+            smatch.spans_.emplace_back(smatch_type::npos, smatch_type::npos);
+        }
+    }
+    return true;
+}
+
+bool myRegex::match(const std::string &str_, mySmatch &smatch) {
+    if(groups().empty() && !match(str_)) return false;
+    return fillSmatch(str_, 0, str_.size(), smatch);
+}
+
+size_t myRegex::longestMatch(std::string_view str, size_t from) {
+    if(engine_ != engine_type::dfa && backreference_matcher_.isEmpty()) {
+        tag_type::tag_value end;
+        if(engine_ == engine_type::counting_nfa) end = counting_automata_.longestMatch(str, from);
+        else if(engine_ == engine_type::lazy_dfa) end = lazy_automata_.longestMatch(str, from);
+        else end = pike_vm_.longestMatch(str, from);
+        return end == tag_type::empty ? smatch_type::npos : end;
+    }
+    if(engine_ == engine_type::dfa && backreference_matcher_.isEmpty()) {
+        tag_type::tag_value end = table_->longestMatch(str, from);
+        return end == tag_type::empty ? smatch_type::npos : end;
+    }
+    // The prefilter rules out the starts without candidate ends, one search of the matcher
+    // gives the exact ends of the others
+    if(engine_ == engine_type::lazy_dfa) lazy_automata_.matchEnds(str, from, ends_);
+    else if(engine_ == engine_type::pike_vm) pike_vm_.matchEnds(str, from, ends_);
+    else table_->matchEnds(str, from, ends_);
+    if(ends_.empty()) return smatch_type::npos;
+    backreference_matcher_.matchEnds(str, from, ends_);
+    return ends_.empty() ? smatch_type::npos : ends_.back();
+}
+
+size_t myRegex::nextStart(std::string_view str, size_t from) const {
+    if(!literal_automata_) return from;
+    return literal_automata_->leftmostStart(str, from);
+}
+
+std::vector<std::string_view> myRegex::findall(const std::string &str_) {
+    std::vector<std::string_view> result;
+    size_t pos = 0;
+    while (pos <= str_.size()) {
+        pos = nextStart(str_, pos);
+        if(pos == smatch_type::npos) break;
+        size_t end = longestMatch(str_, pos);
+        if(end == smatch_type::npos) { ++pos; continue; }
+        result.emplace_back(str_.data() + pos, end - pos);
+        pos = end == pos ? pos + 1 : end;
+    }
+    return result;
+}
+
+size_t myRegex::findallSpans(std::string_view str, std::vector<std::pair<size_t, size_t>> &spans) {
+    spans.clear();
+    size_t pos = 0;
+    while (pos <= str.size()) {
+        pos = nextStart(str, pos);
+        if(pos == smatch_type::npos) break;
+        size_t end = longestMatch(str, pos);
+        if(end == smatch_type::npos) { ++pos; continue; }
+        spans.emplace_back(pos, end);
+        pos = end == pos ? pos + 1 : end;
+    }
+    return spans.size();
+}
+
+bool myRegex::matchFile(const std::string &path) {
+    MappedFile file(path);
+    return accepts(file.view());
+}
+
+size_t myRegex::findallFile(const std::string &path, std::vector<std::pair<size_t, size_t>> &spans) {
+    MappedFile file(path);
+    return findallSpans(file.view(), spans);
+}
+
+size_t myRegex::findall(const std::string &str_, std::vector<mySmatch> &smatches) {
+    size_t count = 0;
+    size_t pos = 0;
+    while (pos <= str_.size()) {
+        pos = nextStart(str_, pos);
+        if(pos == smatch_type::npos) break;
+        size_t end = longestMatch(str_, pos);
+        if(end == smatch_type::npos) { ++pos; continue; }
+        if(count == smatches.size()) smatches.emplace_back();
+        fillSmatch(str_, pos, end, smatches[count]);
+        ++count;
+        pos = end == pos ? pos + 1 : end;
+    }
+    smatches.resize(count);
+    return count;
+}
+
+engine_type::engine myRegex::engine() const noexcept { return engine_; }
+
+engine_type::engine myRegex::searchEngine() const noexcept {
+    return literal_automata_ ? engine_type::aho_corasick : engine_;
+}
+
+engine_type::engine myRegex::captureEngine() const noexcept {
+    if(groups().empty()) return engine_type::none;
+    if(!backreference_matcher_.isEmpty()) return engine_type::backreference;
+    if(!pike_vm_.isEmpty()) return engine_type::pike_vm;
+    return engine_type::tagged_dfa;
+}
+
+size_t myRegex::groupIndex(std::string_view name) const {
+    auto const& names = groups();
+    for (size_t i = 0; i < names.size(); ++i) {
+        if(names[i] == name) return i;
+    }
+    throw std::logic_error("Capture group is not founded");
 }
 
 myRegex &myRegex::inverse() {
+    if(!backreference_matcher_.isEmpty()) throw std::logic_error("Language operations with back references are not supported");
+    if(!pattern_.empty()) {
+        DerivativeBuilder builder;
+        PatternString pattern(pattern_);
+        unsigned int term = builder.reverse(pattern.generateSyntaxTree().generateTerm(builder));
+        SynthesisBudget budget(options_.max_dfa_states_, options_.max_memory_, options_.max_compile_time_);
+        if(builder.synthesis(term, automata_, budget)) {
+            optimizeDFA();
+            resetToDFA();
+            pattern_.clear();
+            return *this;
+        }
+    }
+    if(!hasDFA()) throw std::logic_error("Language operations need the DFA, it is out of the states budget");
     AutomataConverter converter(&automata_);
     converter.convert();
     PatternString pattern(converter.getExpr());
     NFA_Automata * NFA =  pattern.generateInverseSyntaxTree().generateNFA();
     NFA->printDOT("nfa");
-    automata_.synthesisFromNFA(NFA);
-    automata_.optimize();
+    automata_.synthesisFromNFA(NFA, SynthesisBudget(), options_.merge_kernels_, options_.synthesis_threads_);
+    optimizeDFA();
+    resetToDFA();
+    pattern_.clear();
     automata_.printDOT("dfa");
     return *this;
 }
@@ -59,6 +448,25 @@ std::vector<State *> myRegex::findAllStates(State * start) {
 }
 
 myRegex &myRegex::substract(const myRegex &other_regex) {
+    if(!backreference_matcher_.isEmpty() || !other_regex.backreference_matcher_.isEmpty()) {
+        throw std::logic_error("Language operations with back references are not supported");
+    }
+    // Difference is the intersection with the complement, the derivatives take both directly
+    if(!pattern_.empty() && !other_regex.pattern_.empty()) {
+        DerivativeBuilder builder;
+        PatternString main_pattern(pattern_);
+        PatternString ordinary_pattern(other_regex.pattern_);
+        unsigned int main_term = main_pattern.generateSyntaxTree().generateTerm(builder);
+        unsigned int ordinary_term = ordinary_pattern.generateSyntaxTree().generateTerm(builder);
+        SynthesisBudget budget(options_.max_dfa_states_, options_.max_memory_, options_.max_compile_time_);
+        if(builder.synthesis(builder.intersection(main_term, builder.complement(ordinary_term)), automata_, budget)) {
+            optimizeDFA();
+            resetToDFA();
+            pattern_.clear();
+            return *this;
+        }
+    }
+    if(!hasDFA() || !other_regex.hasDFA()) throw std::logic_error("Language operations need the DFA, it is out of the states budget");
     auto main_automata = automata_;
     auto ordinary_automata = other_regex.automata_;
 
@@ -115,14 +523,14 @@ myRegex &myRegex::substract(const myRegex &other_regex) {
     }
 
     automata_ = DFA_Automata(start);
-    automata_.optimize();
+    optimizeDFA();
+    resetToDFA();
+    pattern_.clear();
 
     return *this;
 }
 
-myRegex::myRegex(const std::string &str, syntax_option_type::syntax_option type) {
-    PatternString pattern(str);
-    NFA_Automata * NFA =  pattern.generateSyntaxTree().generateNFA();
-    automata_.synthesisFromNFA(NFA);
-    if(type == syntax_option_type::optimize) { automata_.optimize(); }
+myRegex::myRegex(const std::string &str, syntax_option_type::syntax_option type, CompileOptions const& options) {
+    options_ = options;
+    compile(str, type == syntax_option_type::optimize);
 }
\ No newline at end of file
@@ -1,7 +1,20 @@
 #include <string>
+#include <string_view>
+#include <span>
 #include "syntaxTree.h"
 #include "DFA.h"
 #include "LangOperations.h"
+#include "TaggedDFA.h"
+#include "BackReference.h"
+#include "PikeVM.h"
+#include "LazyDFA.h"
+#include "CountingNFA.h"
+#include "Derivative.h"
+#include "CompiledDFA.h"
+#include "MappedFile.h"
+#include "AhoCorasick.h"
+#include <chrono>
+#include <memory>
 
 #ifndef LAB2_MYREGEX_H
 #define LAB2_MYREGEX_H
@@ -11,34 +24,180 @@ namespace syntax_option_type {
     inline constexpr syntax_option optimize = 1;
 }
 
-struct CaptureGroupStr {
-    std::string name_;
-    std::string str_;
-    std::string str_freeze_;
-    bool active_;
-};
+namespace regex_options {
+    inline constexpr unsigned long max_dfa_states = 10000;
+    inline constexpr unsigned long max_memory = 64ul << 20;
+    inline constexpr std::chrono::milliseconds max_compile_time = std::chrono::seconds(5);
+}
 
-class CaptureGroupCollector {
-    std::map<std::string, CaptureGroupStr> collector;
+// When a limit is exceeded the DFA is replaced with the lazy DFA (its cache gets the same
+// limits, but at least lazy_dfa_options::min_cache_states states) or with the Pike VM if
+// the lazy DFA is disabled or the memory is too small for the minimum cache
+struct CompileOptions {
+    unsigned long max_dfa_states_ = regex_options::max_dfa_states;
+    unsigned long max_memory_ = regex_options::max_memory;
+    std::chrono::milliseconds max_compile_time_ = regex_options::max_compile_time;
+    bool lazy_dfa_ = true;
+    // Repeats {n} of single symbols with n at least this value use counters instead of copies,
+    // the DFA is not built then. 0 turns it off
+    unsigned int counting_threshold_ = 0;
+    // Rewrites the syntax tree with SyntaxTree::simplify before the NFA is built
+    bool simplify_ = true;
+    // Patterns without capture groups are determinized from the epsilon-free position automata
+    bool position_nfa_ = true;
+    // Patterns without capture groups are determinized by derivatives of the syntax tree
+    // instead of an NFA, this goes before position_nfa_
+    bool derivative_dfa_ = false;
+    // Subset construction keys the sets by their important states only (the ones reading
+    // symbols, the end and the flagged ones), so sets differing in epsilon pass-through states
+    // are one DFA state. Only the Thompson NFA has such states: patterns with capture groups,
+    // or all patterns with position_nfa_ and derivative_dfa_ off. It is no equivalence merging,
+    // the DFA still needs optimize to be minimal
+    bool merge_kernels_ = true;
+    // Worker threads of the subset construction, 0 is all hardware threads
+    unsigned int synthesis_threads_ = 1;
+    // The DFA is minimized by rounds of Moore refinement on this many threads instead of
+    // splitting the groups one by one, 0 is all hardware threads
+    bool moore_minimization_ = false;
+    unsigned int minimization_threads_ = 0;
+    // Alternations of plain strings get the DFA straight from the strings, and findall looks
+    // for the match starts with an Aho–Corasick automaton of the strings
+    bool literal_search_ = true;
+    // Compiled DFA states leaving their most common next state by at most this count of
+    // bytes store these bytes only instead of a row of 256 states: smaller but slower tables.
+    // Tables over max_memory_ get sparse rows anyway
+    unsigned int sparse_degree_ = compiled_state::all_dense;
 };
 
+namespace engine_type {
+    typedef unsigned char engine;
+    inline constexpr engine none = 0;
+    inline constexpr engine dfa = 1;
+    inline constexpr engine lazy_dfa = 2;
+    inline constexpr engine pike_vm = 3;
+    inline constexpr engine tagged_dfa = 4;
+    inline constexpr engine backreference = 5;
+    inline constexpr engine counting_nfa = 6;
+    inline constexpr engine aho_corasick = 7;
+
+    [[nodiscard]] std::string_view name(engine type) noexcept;
+}
+
+namespace smatch_type {
+    typedef std::pair<size_t, size_t> span;
+    inline constexpr size_t npos = static_cast<size_t>(-1);
+}
+
+// Holds a pointer to the matched string and offsets only: the string must outlive the object.
+// The group names are shared with the regex and stay valid when it is changed or destroyed
 class mySmatch {
-    CaptureGroupCollector collector_;
+    const char * str_ = nullptr;
+    smatch_type::span match_ = {smatch_type::npos, smatch_type::npos};
+    std::vector<smatch_type::span> spans_;
+    std::shared_ptr<const std::vector<std::string>> names_;
+    friend class myRegex;
 public:
+    class const_iterator {
+        mySmatch const* smatch_;
+        size_t index_;
+    public:
+        const_iterator(mySmatch const* smatch, size_t index) : smatch_(smatch), index_(index) {}
+        std::string_view operator*() const { return (*smatch_)[index_]; }
+        const_iterator & operator++() { ++index_; return *this; }
+        bool operator==(const_iterator const& other) const { return index_ == other.index_; }
+    };
+
     mySmatch() = default;
+    [[nodiscard]] std::string_view operator[](size_t index) const;
+    [[nodiscard]] std::string_view operator[](std::string_view name) const;
+    [[nodiscard]] bool matched(size_t index) const;
+    [[nodiscard]] std::string_view name(size_t index) const;
+    [[nodiscard]] std::string_view str() const;
+    [[nodiscard]] size_t position() const noexcept;
+    [[nodiscard]] size_t length() const noexcept;
+    [[nodiscard]] const_iterator begin() const noexcept;
+    [[nodiscard]] const_iterator end() const noexcept;
+    [[nodiscard]] size_t size() const noexcept;
     ~mySmatch() = default;
 };
 
+// Copies share the compiled table and the literal automaton, which are never changed in place
+// but for the search table built once by the first search, and get their own scratch state:
+// a copy per thread matches concurrently
 class myRegex {
     DFA_Automata automata_;
+    std::shared_ptr<const CompiledDFA> table_ = std::make_shared<const CompiledDFA>();
+    TaggedDFA_Automata tagged_automata_;
+    BackReferenceMatcher backreference_matcher_;
+    PikeVM pike_vm_;
+    LazyDFA_Automata lazy_automata_;
+    CountingNFA_Automata counting_automata_;
+    // Empty without the literal search
+    std::shared_ptr<const AhoCorasick> literal_automata_;
+    CompileOptions options_;
+    // Source of the language of the DFA for the derivative language operations,
+    // empty after inverse and substract
+    std::string pattern_;
+    engine_type::engine engine_ = engine_type::dfa;
+    std::vector<MinimizationRound> minimization_rounds_;
+    std::vector<tag_type::tag_value> registers_;
+    std::vector<tag_type::tag_value> ends_;
+    std::vector<tag_type::tag_value> starts_;
+    // Copy of groups() handed to the matches, made by the first fillSmatch after a compile
+    std::shared_ptr<const std::vector<std::string>> group_names_;
     std::vector<State*> findAllStates(State * start);
+    size_t longestMatch(std::string_view str, size_t from);
+    // First position from 'from' where a match may start, smatch_type::npos if there is none
+    [[nodiscard]] size_t nextStart(std::string_view str, size_t from) const;
+    bool fillSmatch(std::string_view str, size_t from, size_t to, mySmatch & smatch);
+    bool accepts(std::string_view str_);
+    void compile(std::string const& str, bool optimize = false);
+    void fallbackFromNFA(const NFA_Automata * nfa_auto);
+    void synthesisFromNFA(const NFA_Automata * nfa_auto, bool optimize = false);
+    void resetToDFA(bool optimize = false);
+    void compileTable(bool optimize);
+    void optimizeDFA();
+    [[nodiscard]] bool hasDFA() const noexcept;
+    [[nodiscard]] std::vector<std::string> const& groups() const noexcept;
+    myRegex() = default;
 public:
-    explicit myRegex(std::string const& str, syntax_option_type::syntax_option type);
+    explicit myRegex(std::string const& str, syntax_option_type::syntax_option type, CompileOptions const& options = CompileOptions());
     explicit myRegex(std::string const& str);
+    // Alternation of the strings taken literally, the minimal DFA is built directly without
+    // the syntax tree in a time linear in the total length of sorted strings
+    [[nodiscard]] static myRegex fromLiterals(std::vector<std::string> const& literals, CompileOptions const& options = CompileOptions());
     myRegex & inverse();
     myRegex & substract(myRegex const& other_regex);
-    //bool match(std::string const& str_, mySmatch & smatch);
+    // Patterns with back references give no match when their search runs out of
+    // backreference_options::max_configurations, the matchers don't throw on plain strings
+    bool match(std::string const& str_, mySmatch & smatch);
     bool match(std::string const& str_);
+    // Result of match for every string, DFAs walk several strings at once
+    [[nodiscard]] std::vector<bool> matchBatch(std::span<const std::string_view> strs);
+    // Some prefix of the string matches, the scan stops as soon as the outcome is known
+    bool matchPrefix(std::string const& str_);
+    // Some substring of the string matches, found by one unanchored scan unless there are back references
+    bool search(std::string_view str_);
+    std::vector<std::string_view> findall(std::string const& str_);
+    // Reuses the objects already stored in 'smatches', returns the count of matches
+    size_t findall(std::string const& str_, std::vector<mySmatch> & smatches);
+    // Begin and end offsets of the matches of findall, the vector is reused
+    size_t findallSpans(std::string_view str, std::vector<std::pair<size_t, size_t>> & spans);
+    // The file is mapped instead of read, the results are offsets in the file
+    bool matchFile(std::string const& path);
+    size_t findallFile(std::string const& path, std::vector<std::pair<size_t, size_t>> & spans);
+    [[nodiscard]] size_t groupIndex(std::string_view name) const;
+    // Renumbers the states of the compiled DFA by their visits on the samples, or breadth-first
+    // without samples, so the hot states share cache lines and pages
+    void reorderStates(std::span<const std::string_view> samples = {});
+    // Rounds of the last Moore minimization, empty for the serial one
+    [[nodiscard]] std::vector<MinimizationRound> const& minimizationRounds() const noexcept;
+    // Engine deciding whether the string matches
+    [[nodiscard]] engine_type::engine engine() const noexcept;
+    // Engine finding the match starts of findall
+    [[nodiscard]] engine_type::engine searchEngine() const noexcept;
+    // Engine extracting the capture groups
+    [[nodiscard]] engine_type::engine captureEngine() const noexcept;
 };
 
 
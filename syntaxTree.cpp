@@ -1,6 +1,8 @@
 #include "syntaxTree.h"
 #include <iostream>
 #include <stack>
+#include <algorithm>
+#include <typeinfo>
 
 #include "HiearchyOperations.h"
 #include "DFA.h"
@@ -32,6 +34,23 @@ const Node *Node::parent() { return parent_; }
 
 SymbolNode::SymbolNode(char sym) { s_ = sym; test_name_ = "SymNode"; }
 
+// CharSetNode
+
+CharSetNode::CharSetNode(std::bitset<256> const& symbols) : symbols_(symbols) { test_name_ = "CharSet"; }
+
+std::bitset<256> const &CharSetNode::getSymbols() const noexcept { return symbols_; }
+
+// BackReferenceNode
+
+BackReferenceNode::BackReferenceNode(std::string name) : SymbolNode('<'), name_(std::move(name)) { test_name_ = "BackRef"; }
+
+std::string BackReferenceNode::getName() { return name_; }
+
+bool BackReferenceNode::addGroup(CaptureGroupNode *group) {
+    if(group && !group_) { group_ = group; return CORRECT; }
+    return UNCORRECTED;
+}
+
 // CaptureGroup
 
 CaptureGroupNode::CaptureGroupNode(std::string name): name_(std::move(name)) { test_name_ = "CaptGroupNode"; }
@@ -54,6 +73,12 @@ bool UnaryNode::addNode(Node * node) {
 
 UnaryNode::~UnaryNode() noexcept { delete node_; }
 
+Node *UnaryNode::releaseNode() noexcept {
+    Node * node = node_;
+    node_ = nullptr;
+    return node;
+}
+
 Node * UnaryNode::getNode() { return node_; }
 
 // KleenyStar
@@ -70,6 +95,13 @@ MatchTimes::MatchTimes(Node *node, unsigned int count) : UnaryNode(node), count_
 
 unsigned int MatchTimes::getCount() const noexcept { return count_; }
 
+void MatchTimes::countingMode(const std::bitset<256> &symbols) {
+    counting_ = true;
+    symbols_ = symbols;
+}
+
+bool MatchTimes::isCounting() const noexcept { return counting_; }
+
 // Expression
 
 Expression::Expression(Node *node) : UnaryNode(node) { test_name_ = "Expr"; }
@@ -88,6 +120,13 @@ Node * BinaryNode::getLeft() noexcept { return leftNode_; }
 
 Node * BinaryNode::getRight() noexcept { return rightNode_; }
 
+std::pair<Node *, Node *> BinaryNode::releaseNodes() noexcept {
+    std::pair<Node *, Node *> nodes = {leftNode_, rightNode_};
+    leftNode_ = nullptr;
+    rightNode_ = nullptr;
+    return nodes;
+}
+
 // OrNode
 
 OrNode::OrNode(Node * leftNode, Node * rightNode) : BinaryNode(leftNode, rightNode) { test_name_ = "OR"; }
@@ -101,6 +140,7 @@ AndNode::AndNode(Node * leftNode, Node * rightNode) : BinaryNode(leftNode, right
 SyntaxTree::SyntaxTree(Node *root) {
     if(root) root_ = root;
     else throw std::logic_error("Wrong: nullptr node");
+    resolveBackReferences();
 }
 
 bool SyntaxTree::addRoot(Node *root) {
@@ -110,6 +150,235 @@ bool SyntaxTree::addRoot(Node *root) {
 }
 
 SyntaxTree::~SyntaxTree() noexcept { delete root_; }
+
+void SyntaxTree::collectReferences(Node *node, std::map<std::string, CaptureGroupNode*> & groups, std::vector<BackReferenceNode*> & references) {
+    if(compaireNode<BackReferenceNode>(node)) {
+        references.push_back(dynamic_cast<BackReferenceNode*>(node));
+    } else if(compaireNode<UnaryNode>(node)) {
+        if(compaireNode<CaptureGroupNode>(node)) {
+            auto group = dynamic_cast<CaptureGroupNode*>(node);
+            groups[group->getName()] = group;
+        }
+        collectReferences(dynamic_cast<UnaryNode*>(node)->getNode(), groups, references);
+    } else if(compaireNode<BinaryNode>(node)) {
+        collectReferences(dynamic_cast<BinaryNode*>(node)->getLeft(), groups, references);
+        collectReferences(dynamic_cast<BinaryNode*>(node)->getRight(), groups, references);
+    }
+}
+
+void SyntaxTree::resolveBackReferences() {
+    std::map<std::string, CaptureGroupNode*> groups;
+    std::vector<BackReferenceNode*> references;
+    collectReferences(root_, groups, references);
+    for (auto &i : references) {
+        if(!groups.count(i->getName())) throw std::logic_error("Capture group of back reference is not founded");
+        i->addGroup(groups[i->getName()]);
+    }
+}
+bool SyntaxTree::symbolClass(Node *node, std::bitset<256> &symbols) {
+    if(compaireNode<BackReferenceNode>(node)) return false;
+    if(compaireNode<SymbolNode>(node)) {
+        symbols.set(static_cast<unsigned char>(node->getSymbol()));
+        return true;
+    }
+    if(compaireNode<CharSetNode>(node)) {
+        symbols |= dynamic_cast<CharSetNode*>(node)->getSymbols();
+        return true;
+    }
+    if(compaireNode<Expression>(node)) return symbolClass(dynamic_cast<Expression*>(node)->getNode(), symbols);
+    if(compaireNode<OrNode>(node)) {
+        auto or_node = dynamic_cast<OrNode*>(node);
+        return symbolClass(or_node->getLeft(), symbols) && symbolClass(or_node->getRight(), symbols);
+    }
+    return false;
+}
+
+unsigned long SyntaxTree::markCountingInternal(Node *node, unsigned int min_count) {
+    if(compaireNode<MatchTimes>(node)) {
+        auto repeat = dynamic_cast<MatchTimes*>(node);
+        std::bitset<256> symbols;
+        if(repeat->getCount() >= min_count && symbolClass(repeat->getNode(), symbols)) {
+            repeat->countingMode(symbols);
+            return 1;
+        }
+    }
+    if(compaireNode<UnaryNode>(node)) return markCountingInternal(dynamic_cast<UnaryNode*>(node)->getNode(), min_count);
+    if(compaireNode<BinaryNode>(node)) {
+        auto binary = dynamic_cast<BinaryNode*>(node);
+        return markCountingInternal(binary->getLeft(), min_count) + markCountingInternal(binary->getRight(), min_count);
+    }
+    return 0;
+}
+
+unsigned long SyntaxTree::markCountingRepeats(unsigned int min_count) {
+    std::map<std::string, CaptureGroupNode*> groups;
+    std::vector<BackReferenceNode*> references;
+    collectReferences(root_, groups, references);
+    if(!groups.empty() || !references.empty()) return 0;
+    return markCountingInternal(root_, std::max(min_count, 1u));
+}
+
+// Simplifier
+
+bool SyntaxTree::equalNodes(Node *left, Node *right) {
+    if(typeid(*left) != typeid(*right)) return false;
+    if(compaireNode<BackReferenceNode>(left)) {
+        return dynamic_cast<BackReferenceNode*>(left)->getName() == dynamic_cast<BackReferenceNode*>(right)->getName();
+    }
+    if(compaireNode<SymbolNode>(left)) return left->getSymbol() == right->getSymbol();
+    if(compaireNode<CharSetNode>(left)) {
+        return dynamic_cast<CharSetNode*>(left)->getSymbols() == dynamic_cast<CharSetNode*>(right)->getSymbols();
+    }
+    if(compaireNode<MatchTimes>(left) && dynamic_cast<MatchTimes*>(left)->getCount() != dynamic_cast<MatchTimes*>(right)->getCount()) return false;
+    if(compaireNode<CaptureGroupNode>(left) && dynamic_cast<CaptureGroupNode*>(left)->getName() != dynamic_cast<CaptureGroupNode*>(right)->getName()) return false;
+    if(compaireNode<UnaryNode>(left)) return equalNodes(dynamic_cast<UnaryNode*>(left)->getNode(), dynamic_cast<UnaryNode*>(right)->getNode());
+    if(compaireNode<BinaryNode>(left)) {
+        auto left_binary = dynamic_cast<BinaryNode*>(left);
+        auto right_binary = dynamic_cast<BinaryNode*>(right);
+        return equalNodes(left_binary->getLeft(), right_binary->getLeft()) && equalNodes(left_binary->getRight(), right_binary->getRight());
+    }
+    return true;
+}
+
+bool SyntaxTree::captureFree(Node *node) {
+    if(compaireNode<CaptureGroupNode>(node) || compaireNode<BackReferenceNode>(node)) return false;
+    if(compaireNode<UnaryNode>(node)) return captureFree(dynamic_cast<UnaryNode*>(node)->getNode());
+    if(compaireNode<BinaryNode>(node)) {
+        auto binary = dynamic_cast<BinaryNode*>(node);
+        return captureFree(binary->getLeft()) && captureFree(binary->getRight());
+    }
+    return true;
+}
+
+// The alternations and concatenations are taken apart, their nodes are deleted
+void SyntaxTree::splitAlternatives(Node *node, std::vector<Node *> &alternatives) {
+    if(!compaireNode<OrNode>(node)) { alternatives.push_back(node); return; }
+    auto nodes = dynamic_cast<OrNode*>(node)->releaseNodes();
+    delete node;
+    splitAlternatives(nodes.first, alternatives);
+    splitAlternatives(nodes.second, alternatives);
+}
+
+void SyntaxTree::splitFactors(Node *node, std::vector<Node *> &factors) {
+    if(!compaireNode<AndNode>(node)) { factors.push_back(node); return; }
+    auto nodes = dynamic_cast<AndNode*>(node)->releaseNodes();
+    delete node;
+    splitFactors(nodes.first, factors);
+    splitFactors(nodes.second, factors);
+}
+
+Node *SyntaxTree::leadingFactor(Node *node) {
+    while (compaireNode<AndNode>(node)) node = dynamic_cast<AndNode*>(node)->getLeft();
+    return node;
+}
+
+Node *SyntaxTree::joinAlternatives(const std::vector<Node *> &alternatives) {
+    Node * result = alternatives.back();
+    for (auto i = alternatives.rbegin() + 1; i != alternatives.rend(); ++i) result = new OrNode(*i, result);
+    return result;
+}
+
+Node *SyntaxTree::joinFactors(const std::vector<Node *> &factors) {
+    Node * result = factors.back();
+    for (auto i = factors.rbegin() + 1; i != factors.rend(); ++i) result = new AndNode(*i, result);
+    return result;
+}
+
+// A capture-free alternative equal to an earlier one is dropped wherever it stands: the earlier one
+// already matches the same strings first. Symbol classes and common leading factors are merged
+// between neighbour alternatives only, so the priority of alternatives is kept
+std::vector<Node *> SyntaxTree::simplifyAlternatives(std::vector<Node *> alternatives) {
+    std::vector<Node *> unique;
+    for (auto &i : alternatives) {
+        bool repeated = captureFree(i) && std::any_of(unique.begin(), unique.end(), [&](Node * node) { return equalNodes(node, i); });
+        if(repeated) delete i;
+        else unique.push_back(i);
+    }
+
+    std::vector<Node *> merged;
+    for (auto &i : unique) {
+        std::bitset<256> symbols;
+        if(!merged.empty() && symbolClass(i, symbols) && symbolClass(merged.back(), symbols)) {
+            delete merged.back();
+            delete i;
+            merged.back() = new CharSetNode(symbols);
+        } else {
+            merged.push_back(i);
+        }
+    }
+
+    std::vector<Node *> result;
+    for (unsigned long i = 0; i < merged.size();) {
+        unsigned long j = i + 1;
+        if(compaireNode<AndNode>(merged[i]) && captureFree(merged[i])) {
+            Node * leading = leadingFactor(merged[i]);
+            while (j < merged.size() && compaireNode<AndNode>(merged[j]) && captureFree(merged[j]) && equalNodes(leading, leadingFactor(merged[j]))) ++j;
+        }
+        if(j - i < 2) { result.push_back(merged[i++]); continue; }
+
+        std::vector<Node *> rests;
+        Node * prefix = nullptr;
+        for (; i < j; ++i) {
+            std::vector<Node *> factors;
+            splitFactors(merged[i], factors);
+            if(prefix) delete factors.front();
+            else prefix = factors.front();
+            rests.push_back(joinFactors(std::vector<Node *>(factors.begin() + 1, factors.end())));
+        }
+        result.push_back(new AndNode(prefix, joinAlternatives(simplifyAlternatives(std::move(rests)))));
+    }
+    return result;
+}
+
+// Returns the node that replaces 'node', the replaced nodes are deleted
+Node *SyntaxTree::simplifyNode(Node *node) {
+    if(compaireNode<BinaryNode>(node)) {
+        auto binary = dynamic_cast<BinaryNode*>(node);
+        auto nodes = binary->releaseNodes();
+        Node * left = simplifyNode(nodes.first);
+        Node * right = simplifyNode(nodes.second);
+        if(compaireNode<AndNode>(node)) {
+            delete node;
+            return new AndNode(left, right);
+        }
+        delete node;
+        std::vector<Node *> alternatives;
+        splitAlternatives(left, alternatives);
+        splitAlternatives(right, alternatives);
+        return joinAlternatives(simplifyAlternatives(std::move(alternatives)));
+    }
+    if(!compaireNode<UnaryNode>(node)) return node;
+
+    auto unary = dynamic_cast<UnaryNode*>(node);
+    Node * child = simplifyNode(unary->releaseNode());
+    bool unwrap = compaireNode<Expression>(node) || (compaireNode<MatchTimes>(node) && dynamic_cast<MatchTimes*>(node)->getCount() == 1);
+    if(!unwrap && captureFree(child)) {
+        bool star = compaireNode<KleenyStar>(node);
+        bool optional = compaireNode<Optional>(node);
+        bool child_star = compaireNode<KleenyStar>(child);
+        bool child_optional = compaireNode<Optional>(child);
+        if((star && (child_star || child_optional)) || (optional && child_optional)) {
+            // x** -> x*, (x?)* -> x*, x?? -> x?
+            Node * grandchild = dynamic_cast<UnaryNode*>(child)->releaseNode();
+            delete child;
+            child = grandchild;
+        } else if(optional && child_star) {
+            // (x*)? -> x*
+            unwrap = true;
+        }
+    }
+    if(unwrap) {
+        delete node;
+        return child;
+    }
+    (void)unary->addNode(child);
+    return node;
+}
+
+void SyntaxTree::simplify() {
+    root_ = simplifyNode(root_);
+}
+
 /*
 //CaptureGroupStorage
 
@@ -209,6 +478,163 @@ NFA_Automata * SyntaxTree::generateNFA() {
     return root_->createAutomata();
 }
 
+// Position automata
+
+PositionSets SyntaxTree::concatPositions(PositionSets const& left, PositionSets const& right, std::vector<std::set<unsigned int>> & follow) {
+    for (auto &i : left.last_) follow[i].insert(right.first_.begin(), right.first_.end());
+    PositionSets result;
+    result.nullable_ = left.nullable_ && right.nullable_;
+    result.first_ = left.first_;
+    if(left.nullable_) result.first_.insert(result.first_.end(), right.first_.begin(), right.first_.end());
+    result.last_ = right.last_;
+    if(right.nullable_) result.last_.insert(result.last_.end(), left.last_.begin(), left.last_.end());
+    return result;
+}
+
+PositionSets SyntaxTree::positionsInternal(Node *node, std::vector<Node*> & positions, std::vector<std::set<unsigned int>> & follow) {
+    if(compaireNode<SymbolNode>(node) || compaireNode<CharSetNode>(node)) {
+        unsigned int position = positions.size();
+        positions.push_back(node);
+        follow.emplace_back();
+        return {false, {position}, {position}};
+    }
+    if(compaireNode<EmptyNode>(node)) return {};
+    if(compaireNode<KleenyStar>(node) || compaireNode<Optional>(node)) {
+        PositionSets result = positionsInternal(dynamic_cast<UnaryNode*>(node)->getNode(), positions, follow);
+        if(compaireNode<KleenyStar>(node)) {
+            for (auto &i : result.last_) follow[i].insert(result.first_.begin(), result.first_.end());
+        }
+        result.nullable_ = true;
+        return result;
+    }
+    // Every repeat is a new copy of the positions of the node
+    if(compaireNode<MatchTimes>(node)) {
+        auto repeat = dynamic_cast<MatchTimes*>(node);
+        PositionSets result;
+        for (unsigned int i = 0; i < repeat->getCount(); ++i) {
+            result = concatPositions(result, positionsInternal(repeat->getNode(), positions, follow), follow);
+        }
+        return result;
+    }
+    if(compaireNode<UnaryNode>(node)) return positionsInternal(dynamic_cast<UnaryNode*>(node)->getNode(), positions, follow);
+    if(compaireNode<OrNode>(node)) {
+        auto or_node = dynamic_cast<OrNode*>(node);
+        PositionSets left = positionsInternal(or_node->getLeft(), positions, follow);
+        PositionSets right = positionsInternal(or_node->getRight(), positions, follow);
+        left.nullable_ = left.nullable_ || right.nullable_;
+        left.first_.insert(left.first_.end(), right.first_.begin(), right.first_.end());
+        left.last_.insert(left.last_.end(), right.last_.begin(), right.last_.end());
+        return left;
+    }
+    if(compaireNode<AndNode>(node)) {
+        auto and_node = dynamic_cast<AndNode*>(node);
+        PositionSets left = positionsInternal(and_node->getLeft(), positions, follow);
+        PositionSets right = positionsInternal(and_node->getRight(), positions, follow);
+        return concatPositions(left, right, follow);
+    }
+    throw std::logic_error("Node don't have automata");
+}
+
+bool SyntaxTree::hasCaptureGroups() {
+    std::map<std::string, CaptureGroupNode*> groups;
+    std::vector<BackReferenceNode*> references;
+    collectReferences(root_, groups, references);
+    return !groups.empty() || !references.empty();
+}
+
+bool SyntaxTree::literalInternal(Node *node, std::string &literal) {
+    if(!node || compaireNode<BackReferenceNode>(node)) return false;
+    if(compaireNode<SymbolNode>(node)) {
+        literal += node->getSymbol();
+        return true;
+    }
+    if(compaireNode<Expression>(node)) return literalInternal(dynamic_cast<Expression*>(node)->getNode(), literal);
+    if(compaireNode<AndNode>(node)) {
+        auto and_node = dynamic_cast<AndNode*>(node);
+        return literalInternal(and_node->getLeft(), literal) && literalInternal(and_node->getRight(), literal);
+    }
+    return false;
+}
+
+bool SyntaxTree::alternativeLiterals(Node *node, std::vector<std::string> &literals) {
+    if(compaireNode<Expression>(node)) return alternativeLiterals(dynamic_cast<Expression*>(node)->getNode(), literals);
+    if(compaireNode<OrNode>(node)) {
+        auto or_node = dynamic_cast<OrNode*>(node);
+        return alternativeLiterals(or_node->getLeft(), literals) && alternativeLiterals(or_node->getRight(), literals);
+    }
+    std::string literal;
+    if(!literalInternal(node, literal)) return false;
+    literals.push_back(std::move(literal));
+    return true;
+}
+
+bool SyntaxTree::literals(std::vector<std::string> &literals) {
+    literals.clear();
+    if(alternativeLiterals(root_, literals)) return true;
+    literals.clear();
+    return false;
+}
+
+NFA_Automata *SyntaxTree::generatePositionNFA() {
+    if(hasCaptureGroups()) return nullptr;
+
+    std::vector<Node*> positions;
+    std::vector<std::set<unsigned int>> follow;
+    PositionSets root = positionsInternal(root_, positions, follow);
+
+    // A transition to a position reads the symbols of the position
+    auto connect = [&](State * from, std::vector<State*> const& states, unsigned int to) {
+        if(compaireNode<CharSetNode>(positions[to])) {
+            from->addTransition(new SymbolClassTransition(states[to], dynamic_cast<CharSetNode*>(positions[to])->getSymbols()));
+        } else {
+            from->addTransition(new SymbolTransition(states[to], positions[to]->getSymbol()));
+        }
+    };
+
+    auto start = new State(root.nullable_);
+    std::vector<State*> states;
+    states.reserve(positions.size());
+    for (unsigned int i = 0; i < positions.size(); ++i) states.push_back(new State());
+    for (auto &i : root.last_) states[i]->finishState();
+    for (auto &i : root.first_) connect(start, states, i);
+    for (unsigned int i = 0; i < positions.size(); ++i) {
+        for (auto &b : follow[i]) connect(states[i], states, b);
+    }
+    return new NFA_Automata(start, nullptr);
+}
+
+// Derivative terms
+
+unsigned int SyntaxTree::termInternal(Node *node, DerivativeBuilder &builder) {
+    if(compaireNode<BackReferenceNode>(node)) throw std::logic_error("Language operations with back references are not supported");
+    if(compaireNode<SymbolNode>(node)) return builder.symbols(std::bitset<256>().set(static_cast<unsigned char>(node->getSymbol())));
+    if(compaireNode<CharSetNode>(node)) return builder.symbols(dynamic_cast<CharSetNode*>(node)->getSymbols());
+    if(compaireNode<EmptyNode>(node)) return builder.epsilon();
+    if(compaireNode<KleenyStar>(node)) return builder.star(termInternal(dynamic_cast<UnaryNode*>(node)->getNode(), builder));
+    if(compaireNode<Optional>(node)) {
+        return builder.alternative(builder.epsilon(), termInternal(dynamic_cast<UnaryNode*>(node)->getNode(), builder));
+    }
+    if(compaireNode<MatchTimes>(node)) {
+        auto repeat = dynamic_cast<MatchTimes*>(node);
+        unsigned int repeated = termInternal(repeat->getNode(), builder);
+        unsigned int result = builder.epsilon();
+        for (unsigned int i = 0; i < repeat->getCount(); ++i) result = builder.concat(repeated, result);
+        return result;
+    }
+    if(compaireNode<UnaryNode>(node)) return termInternal(dynamic_cast<UnaryNode*>(node)->getNode(), builder);
+    if(compaireNode<OrNode>(node)) {
+        auto or_node = dynamic_cast<OrNode*>(node);
+        return builder.alternative(termInternal(or_node->getLeft(), builder), termInternal(or_node->getRight(), builder));
+    }
+    if(compaireNode<AndNode>(node)) {
+        auto and_node = dynamic_cast<AndNode*>(node);
+        return builder.concat(termInternal(and_node->getLeft(), builder), termInternal(and_node->getRight(), builder));
+    }
+    throw std::logic_error("Node don't have automata");
+}
+
+unsigned int SyntaxTree::generateTerm(DerivativeBuilder &builder) { return termInternal(root_, builder); }
+
 void printSpaces(int count) {
     for (int i = 0; i < count; ++i) {
         for (int j = 0; j < 3; ++j) {
@@ -218,7 +644,12 @@ void printSpaces(int count) {
 }
 
 void SyntaxTree::treewalkInternal(Node *node, int & height) {
-    if(compaireNode<UnaryNode>(node)) {
+    if(compaireNode<BackReferenceNode>(node)) {
+        ++height;
+        printSpaces(height);
+        std::cout << "ref: <" << dynamic_cast<BackReferenceNode*>(node)->getName() << ">" << std::endl;
+        --height;
+    } else if(compaireNode<UnaryNode>(node)) {
         auto unary = dynamic_cast<UnaryNode*>(node);
         ++height;
         printSpaces(height);
@@ -238,6 +669,16 @@ void SyntaxTree::treewalkInternal(Node *node, int & height) {
         printSpaces(height);
         std::cout << "sym: '" << node->getSymbol() << "'" << std::endl;
         --height;
+    } else if(compaireNode<CharSetNode>(node)) {
+        auto const& symbols = dynamic_cast<CharSetNode*>(node)->getSymbols();
+        ++height;
+        printSpaces(height);
+        std::cout << "set: '";
+        for (unsigned int i = 0; i < symbols.size(); ++i) {
+            if(symbols.test(i)) std::cout << static_cast<char>(i);
+        }
+        std::cout << "'" << std::endl;
+        --height;
     }
 }
 
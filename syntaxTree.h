@@ -4,7 +4,11 @@
 #include <list>
 #include <string>
 #include <map>
+#include <bitset>
+#include <set>
+#include <vector>
 #include "NFA.h"
+#include "Derivative.h"
 
 class AutomataBuilder {
 protected:
@@ -48,6 +52,30 @@ public:
     ~SymbolNode() override = default;
 };
 
+class CaptureGroupNode;
+
+class BackReferenceNode : public SymbolNode {
+    std::string name_;
+    CaptureGroupNode * group_ = nullptr;
+    bool inProcess_ = false;
+public:
+    explicit BackReferenceNode(std::string name);
+    [[nodiscard]] std::string getName();
+    bool addGroup(CaptureGroupNode * group);
+    NFA_Automata * createAutomata() final;
+    ~BackReferenceNode() override = default;
+};
+
+// One of the symbols, made by the simplifier from alternations of single symbols
+class CharSetNode : public Node, public DefineNode {
+    std::bitset<256> symbols_;
+public:
+    explicit CharSetNode(std::bitset<256> const& symbols);
+    [[nodiscard]] std::bitset<256> const& getSymbols() const noexcept;
+    NFA_Automata * createAutomata() final;
+    ~CharSetNode() override = default;
+};
+
 class EmptyNode : public Node {
 public:
     EmptyNode() = default;
@@ -62,6 +90,8 @@ public:
     explicit UnaryNode(Node * node);
     [[nodiscard]] bool addNode(Node * node);
     [[nodiscard]] Node * getNode();
+    // The node is not owned anymore
+    [[nodiscard]] Node * releaseNode() noexcept;
     ~UnaryNode() noexcept override;
 };
 
@@ -98,10 +128,15 @@ public:
 
 class MatchTimes : public UnaryNode {
     unsigned int count_ = 0;
+    bool counting_ = false;
+    std::bitset<256> symbols_;
 public:
     MatchTimes() = default;
     explicit MatchTimes(Node * node, unsigned int count);
     [[nodiscard]] unsigned int getCount() const noexcept;
+    // The node matches one of 'symbols' and is repeated with a counter instead of copies
+    void countingMode(std::bitset<256> const& symbols);
+    [[nodiscard]] bool isCounting() const noexcept;
     NFA_Automata * createAutomata() final;
     ~MatchTimes() override = default;
 };
@@ -123,6 +158,8 @@ protected:
 public:
     [[nodiscard]] Node * getLeft() noexcept;
     [[nodiscard]] Node *getRight() noexcept;
+    // The nodes are not owned anymore
+    [[nodiscard]] std::pair<Node*, Node*> releaseNodes() noexcept;
 };
 
 class OrNode : public BinaryNode {
@@ -139,15 +176,59 @@ public:
     ~AndNode() override = default;
 };
 
+// Nullable, first and last sets of a subtree of the position automata
+struct PositionSets {
+    bool nullable_ = true;
+    std::vector<unsigned int> first_;
+    std::vector<unsigned int> last_;
+};
+
 class SyntaxTree {
     Node * root_ = nullptr;
     void treewalkInternal(Node * node, int & height);
+    void collectReferences(Node * node, std::map<std::string, CaptureGroupNode*> & groups, std::vector<BackReferenceNode*> & references);
+    [[nodiscard]] static bool symbolClass(Node * node, std::bitset<256> & symbols);
+    [[nodiscard]] static bool equalNodes(Node * left, Node * right);
+    [[nodiscard]] static bool captureFree(Node * node);
+    static void splitAlternatives(Node * node, std::vector<Node*> & alternatives);
+    static void splitFactors(Node * node, std::vector<Node*> & factors);
+    [[nodiscard]] static Node * leadingFactor(Node * node);
+    [[nodiscard]] static Node * joinAlternatives(std::vector<Node*> const& alternatives);
+    [[nodiscard]] static Node * joinFactors(std::vector<Node*> const& factors);
+    [[nodiscard]] static std::vector<Node*> simplifyAlternatives(std::vector<Node*> alternatives);
+    [[nodiscard]] static Node * simplifyNode(Node * node);
+    unsigned long markCountingInternal(Node * node, unsigned int min_count);
+    static PositionSets positionsInternal(Node * node, std::vector<Node*> & positions, std::vector<std::set<unsigned int>> & follow);
+    static unsigned int termInternal(Node * node, DerivativeBuilder & builder);
+    [[nodiscard]] static bool literalInternal(Node * node, std::string & literal);
+    [[nodiscard]] static bool alternativeLiterals(Node * node, std::vector<std::string> & literals);
+    static PositionSets concatPositions(PositionSets const& left, PositionSets const& right, std::vector<std::set<unsigned int>> & follow);
     //void paintGraph(Node *node, int & height);
 public:
     SyntaxTree() = default;
     explicit SyntaxTree(Node * root);
     NFA_Automata * generateNFA();
+    // Glushkov automata: one state per symbol position plus the start and no epsilon transitions.
+    // Accepting states are flagged with State::finishState, the end connector is nullptr.
+    // Returns nullptr for trees with capture groups or back references, positions don't keep tags
+    NFA_Automata * generatePositionNFA();
+    // Term of the language for the derivative construction, capture groups only keep their
+    // language. Throws for back references: their language is not regular
+    unsigned int generateTerm(DerivativeBuilder & builder);
+    [[nodiscard]] bool hasCaptureGroups();
+    // Alternatives of the pattern if every one of them is a string of single symbols,
+    // parentheses aside. Call before simplify, it merges the symbols into sets
+    [[nodiscard]] bool literals(std::vector<std::string> & literals);
     bool addRoot(Node * root);
+    void resolveBackReferences();
+    // Repeats of single symbol classes at least 'min_count' times become counting ones,
+    // patterns with capture groups are kept as is. Returns the count of changed repeats
+    unsigned long markCountingRepeats(unsigned int min_count);
+    // Rewrites the tree with the identities of regular expressions: x**, (x*)?, (x?)* -> x*,
+    // x?? -> x?, x{1} -> x, repeated alternatives are removed, alternatives of single symbols
+    // are merged into sets and common leading factors are taken out of alternations.
+    // Subtrees with capture groups are kept as is, so the captures don't change
+    void simplify();
     void treeWalk();
     ~SyntaxTree() noexcept;
 };